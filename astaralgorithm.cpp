@@ -0,0 +1,666 @@
+#include "astaralgorithm.h"
+#include "routingalgorithmregistry.h"
+#include "robot.h"
+
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+static const StaticAlgorithmRegistration registrar( "A*", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new AStarAlgorithm( false ) );
+} );
+
+static const StaticAlgorithmRegistration jump_point_registrar( "A* (jump points)", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new AStarAlgorithm( true ) );
+} );
+
+/* Costs of a step, scaled so that they stay integers. */
+static const uint32_t straight_cost = 10;
+static const uint32_t diagonal_cost = 14;
+
+static const uint32_t no_parent = 0xffffffff;
+
+/* The eight neighbours; the straight ones first, then every diagonal one between two of them. */
+static const int direction_x[ 8 ] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int direction_y[ 8 ] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+struct SearchNode
+{
+    uint32_t generation;
+    uint32_t g;
+    uint32_t parent;
+    uint8_t is_closed;
+};
+
+/*
+ * Storage for a search, sized to the map and kept between searches, so
+ * that planning doesn't allocate anything once it has warmed up. Nodes
+ * only count when stamped with the current generation, so nothing has
+ * to be cleared between the searches either. The algorithms of different
+ * robots run at the same time, so every thread gets its own.
+ */
+struct SearchArena
+{
+    std::vector< SearchNode > nodes;
+
+    /* A binary heap of (f << 32) | index, with the smallest f first. */
+    std::vector< uint64_t > open;
+
+    uint32_t generation;
+
+    SearchArena() : generation( 0 ) {}
+
+    SearchNode& node( const uint32_t index )
+    {
+        return nodes[ index ];
+    }
+
+    void begin( const std::size_t node_count )
+    {
+        if( nodes.size() < node_count )
+        {
+            nodes.resize( node_count );
+            open.reserve( node_count );
+        }
+
+        open.clear();
+        if( ++generation == 0 )
+        {
+            for( SearchNode& node: nodes )
+                node.generation = 0;
+
+            generation = 1;
+        }
+    }
+};
+
+static thread_local SearchArena arena;
+
+/*
+ * A search which ran out of its budget, kept by the robot's algorithm
+ * until it's continued, on whichever thread that happens. Only the
+ * blocks it has reached are stored, since a whole map's worth for every
+ * robot in the middle of planning would be far too much.
+ */
+struct SuspendedSearch
+{
+    std::unordered_map< uint32_t, SearchNode > nodes;
+    std::vector< uint64_t > open;
+    uint32_t generation;
+
+    /* What it's a search for. */
+    uint32_t start;
+    unsigned goal_x;
+    unsigned goal_y;
+
+    SuspendedSearch( const uint32_t from, const unsigned to_x, const unsigned to_y ) :
+        generation( 1 ),
+        start( from ),
+        goal_x( to_x ),
+        goal_y( to_y )
+    {
+    }
+
+    void begin( const std::size_t )
+    {
+        nodes.clear();
+        open.clear();
+    }
+
+    /* Blocks which haven't been reached yet come out with the generation of zero, like in the arena. */
+    SearchNode& node( const uint32_t index )
+    {
+        return nodes[ index ];
+    }
+
+    /* Whenever the block at @a x, @a y, or any around it, has been reached, so a wall there could change the search. */
+    bool has_reached_around( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+    {
+        for( int dy = -1; dy <= 1; ++dy )
+        {
+            for( int dx = -1; dx <= 1; ++dx )
+            {
+                const int around_x = int( x ) + dx;
+                const int around_y = int( y ) + dy;
+                if( around_x < 0 || around_y < 0 || around_x >= int( width ) || around_y >= int( height ) )
+                    continue;
+
+                const auto node = nodes.find( uint32_t( around_y ) * width + uint32_t( around_x ) );
+                if( node != nodes.end() && node->second.generation == generation )
+                    return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+enum class SearchResult
+{
+    Found,
+    NotFound,
+    OutOfBudget
+};
+
+/*
+ * One search from the robot's block to its goal, over its obstacle map,
+ * with its nodes kept in either a SearchArena or a SuspendedSearch.
+ */
+template< typename Storage >
+class GridSearch
+{
+    Storage& m_storage;
+    const TiledArray2d< ObstacleType >& m_map;
+    const int m_width;
+    const int m_height;
+    const int m_goal_x;
+    const int m_goal_y;
+
+    bool is_free( const int x, const int y ) const
+    {
+        return x >= 0 && y >= 0 && x < m_width && y < m_height && m_map.at( x, y ) != ObstacleType::Wall;
+    }
+
+    /* Whenever there's nothing at all in the tile of the map containing a point, or the point is outside of the map. */
+    bool is_untouched( const int x, const int y ) const
+    {
+        return x < 0 || y < 0 || x >= m_width || y >= m_height || m_map.is_untouched_tile( x, y );
+    }
+
+    /*
+     * The last block, going from a given one in a given direction, of the
+     * run of tiles the block is in; the tiles are aligned on both axes.
+     */
+    static int last_in_tile( const int position, const int direction )
+    {
+        const int tile_size = TiledArray2d< ObstacleType >::tile_size;
+        return direction > 0 ? (position | (tile_size - 1)) : (position & ~(tile_size - 1));
+    }
+
+    /* The octile distance, which is exact when nothing is in the way. */
+    static uint32_t distance( const int x0, const int y0, const int x1, const int y1 )
+    {
+        const uint32_t dx = std::abs( x1 - x0 );
+        const uint32_t dy = std::abs( y1 - y0 );
+
+        return straight_cost * std::max( dx, dy ) + (diagonal_cost - straight_cost) * std::min( dx, dy );
+    }
+
+    void reach( const int x, const int y, const uint32_t g, const uint32_t parent )
+    {
+        const uint32_t index = y * m_width + x;
+        SearchNode& node = m_storage.node( index );
+
+        if( node.generation == m_storage.generation && (node.is_closed || node.g <= g) )
+            return;
+
+        node.generation = m_storage.generation;
+        node.g = g;
+        node.parent = parent;
+        node.is_closed = 0;
+
+        const uint64_t f = g + distance( x, y, m_goal_x, m_goal_y );
+        m_storage.open.push_back( (f << 32) | index );
+        std::push_heap( m_storage.open.begin(), m_storage.open.end(), std::greater< uint64_t >() );
+    }
+
+    void expand_neighbours( const int x, const int y, const uint32_t g, const uint32_t index )
+    {
+        bool is_straight_free[ 4 ];
+        for( unsigned i = 0; i < 4; ++i )
+        {
+            is_straight_free[ i ] = is_free( x + direction_x[ i ], y + direction_y[ i ] );
+            if( is_straight_free[ i ] )
+                reach( x + direction_x[ i ], y + direction_y[ i ], g + straight_cost, index );
+        }
+
+        /* A diagonal step is only allowed when both of the straight ones next to it are. */
+        for( unsigned i = 4; i < 8; ++i )
+        {
+            const unsigned horizontal = direction_x[ i ] > 0 ? 0 : 2;
+            const unsigned vertical = direction_y[ i ] > 0 ? 1 : 3;
+            if( is_straight_free[ horizontal ] && is_straight_free[ vertical ] && is_free( x + direction_x[ i ], y + direction_y[ i ] ) )
+                reach( x + direction_x[ i ], y + direction_y[ i ], g + diagonal_cost, index );
+        }
+    }
+
+    /*
+     * Walks straight from a block until it either runs into a wall or
+     * reaches a block from which a shorter path could turn off sideways.
+     *
+     * Every step of the walk is taken out of @a io_budget; once that runs
+     * out, the block it got to is handed back as if it was a jump point,
+     * and the walk carries on from there when that one is gone through.
+     */
+    bool jump_straight( int x, int y, const int dx, const int dy, std::size_t& io_budget, int& o_x, int& o_y ) const
+    {
+        for( ;; x += dx, y += dy )
+        {
+            if( !is_free( x, y ) )
+                return false;
+
+            if( x == m_goal_x && y == m_goal_y )
+                break;
+
+            if( dx != 0 && ((is_free( x, y - 1 ) && !is_free( x - dx, y - 1 )) || (is_free( x, y + 1 ) && !is_free( x - dx, y + 1 ))) )
+                break;
+
+            if( dy != 0 && ((is_free( x - 1, y ) && !is_free( x - 1, y - dy )) || (is_free( x + 1, y ) && !is_free( x + 1, y - dy ))) )
+                break;
+
+            if( io_budget == 0 )
+                break;
+
+            io_budget--;
+
+            /*
+             * Most of what the robot hasn't seen yet is in tiles nobody has
+             * written to; nothing in a run of those can stop the walk.
+             */
+            if( dx != 0 && is_untouched( x, y - 1 ) && is_untouched( x, y ) && is_untouched( x, y + 1 ) )
+            {
+                const int last = last_in_tile( x, dx );
+                if( y != m_goal_y || (m_goal_x - x) * dx <= 0 || (last - m_goal_x) * dx < 0 )
+                    x = last;
+            }
+            else if( dy != 0 && is_untouched( x - 1, y ) && is_untouched( x, y ) && is_untouched( x + 1, y ) )
+            {
+                const int last = last_in_tile( y, dy );
+                if( x != m_goal_x || (m_goal_y - y) * dy <= 0 || (last - m_goal_y) * dy < 0 )
+                    y = last;
+            }
+        }
+
+        o_x = x;
+        o_y = y;
+        return true;
+    }
+
+    /* Like jump_straight(), with the walks sideways from every block taken out of @a io_budget as well. */
+    bool jump_diagonal( int x, int y, const int dx, const int dy, std::size_t& io_budget, int& o_x, int& o_y ) const
+    {
+        for( ;; x += dx, y += dy )
+        {
+            if( !is_free( x, y ) )
+                return false;
+
+            int unused_x, unused_y;
+            if( (x == m_goal_x && y == m_goal_y) ||
+                jump_straight( x + dx, y, dx, 0, io_budget, unused_x, unused_y ) ||
+                jump_straight( x, y + dy, 0, dy, io_budget, unused_x, unused_y ) )
+                break;
+
+            if( io_budget == 0 )
+                break;
+
+            io_budget--;
+
+            if( !is_free( x + dx, y ) || !is_free( x, y + dy ) )
+                return false;
+        }
+
+        o_x = x;
+        o_y = y;
+        return true;
+    }
+
+    void jump( const int x, const int y, const int dx, const int dy, const uint32_t g, const uint32_t index, std::size_t& io_budget )
+    {
+        int jump_x, jump_y;
+        const bool found = (dx != 0 && dy != 0) ? jump_diagonal( x + dx, y + dy, dx, dy, io_budget, jump_x, jump_y )
+                                                : jump_straight( x + dx, y + dy, dx, dy, io_budget, jump_x, jump_y );
+        if( found )
+            reach( jump_x, jump_y, g + distance( x, y, jump_x, jump_y ), index );
+    }
+
+    /* Only the directions in which a path through this block could go without a shortcut around it. */
+    void expand_jump_points( const int x, const int y, const uint32_t g, const uint32_t index, const uint32_t parent, std::size_t& io_budget )
+    {
+        if( parent == no_parent )
+        {
+            for( unsigned i = 0; i < 4; ++i )
+            {
+                if( is_free( x + direction_x[ i ], y + direction_y[ i ] ) )
+                    jump( x, y, direction_x[ i ], direction_y[ i ], g, index, io_budget );
+            }
+
+            for( unsigned i = 4; i < 8; ++i )
+            {
+                if( is_free( x + direction_x[ i ], y ) && is_free( x, y + direction_y[ i ] ) )
+                    jump( x, y, direction_x[ i ], direction_y[ i ], g, index, io_budget );
+            }
+
+            return;
+        }
+
+        const int parent_x = parent % m_width;
+        const int parent_y = parent / m_width;
+        const int dx = (x > parent_x) - (x < parent_x);
+        const int dy = (y > parent_y) - (y < parent_y);
+
+        if( dx != 0 && dy != 0 )
+        {
+            const bool is_vertical_free = is_free( x, y + dy );
+            const bool is_horizontal_free = is_free( x + dx, y );
+
+            if( is_vertical_free )
+                jump( x, y, 0, dy, g, index, io_budget );
+
+            if( is_horizontal_free )
+                jump( x, y, dx, 0, g, index, io_budget );
+
+            if( is_vertical_free && is_horizontal_free )
+                jump( x, y, dx, dy, g, index, io_budget );
+        }
+        else if( dx != 0 )
+        {
+            const bool is_next_free = is_free( x + dx, y );
+            const bool is_below_free = is_free( x, y + 1 );
+            const bool is_above_free = is_free( x, y - 1 );
+
+            if( is_next_free )
+            {
+                jump( x, y, dx, 0, g, index, io_budget );
+                if( is_below_free )
+                    jump( x, y, dx, 1, g, index, io_budget );
+                if( is_above_free )
+                    jump( x, y, dx, -1, g, index, io_budget );
+            }
+
+            if( is_below_free )
+                jump( x, y, 0, 1, g, index, io_budget );
+            if( is_above_free )
+                jump( x, y, 0, -1, g, index, io_budget );
+        }
+        else
+        {
+            const bool is_next_free = is_free( x, y + dy );
+            const bool is_right_free = is_free( x + 1, y );
+            const bool is_left_free = is_free( x - 1, y );
+
+            if( is_next_free )
+            {
+                jump( x, y, 0, dy, g, index, io_budget );
+                if( is_right_free )
+                    jump( x, y, 1, dy, g, index, io_budget );
+                if( is_left_free )
+                    jump( x, y, -1, dy, g, index, io_budget );
+            }
+
+            if( is_right_free )
+                jump( x, y, 1, 0, g, index, io_budget );
+            if( is_left_free )
+                jump( x, y, -1, 0, g, index, io_budget );
+        }
+    }
+
+    public:
+        explicit GridSearch( Storage& storage, const TiledArray2d< ObstacleType >& map, const unsigned goal_x, const unsigned goal_y ) :
+            m_storage( storage ),
+            m_map( map ),
+            m_width( map.width() ),
+            m_height( map.height() ),
+            m_goal_x( goal_x ),
+            m_goal_y( goal_y )
+        {
+        }
+
+        void start( const unsigned start_x, const unsigned start_y )
+        {
+            m_storage.begin( std::size_t( m_width ) * m_height );
+            if( is_free( m_goal_x, m_goal_y ) )
+                reach( start_x, start_y, 0, no_parent );
+        }
+
+        /*
+         * Carries on with the search started by start() until either the
+         * goal is reached, there's nowhere left to go, or @a io_budget runs
+         * out; in the last case it can be continued. Every block gone
+         * through, and every one looked at by a jump, is taken out of it.
+         */
+        SearchResult run( const bool use_jump_points, std::size_t& io_budget )
+        {
+            const uint32_t goal = m_goal_y * m_width + m_goal_x;
+            while( !m_storage.open.empty() )
+            {
+                const uint32_t index = m_storage.open.front() & 0xffffffff;
+                SearchNode& node = m_storage.node( index );
+                if( !node.is_closed )
+                {
+                    if( io_budget == 0 )
+                        return SearchResult::OutOfBudget;
+
+                    io_budget--;
+                }
+
+                std::pop_heap( m_storage.open.begin(), m_storage.open.end(), std::greater< uint64_t >() );
+                m_storage.open.pop_back();
+
+                if( node.is_closed )
+                    continue;
+
+                node.is_closed = 1;
+                if( index == goal )
+                    return SearchResult::Found;
+
+                if( use_jump_points )
+                    expand_jump_points( index % m_width, index / m_width, node.g, index, node.parent, io_budget );
+                else
+                    expand_neighbours( index % m_width, index / m_width, node.g, index );
+            }
+
+            return SearchResult::NotFound;
+        }
+
+        /*
+         * Fills @a o_path with every block on the way of a found path,
+         * the goal first and the one right after the start last.
+         */
+        void trace( std::vector< uint32_t >& o_path )
+        {
+            o_path.clear();
+
+            /* Jump points can be far apart, so fill in the blocks between them. */
+            const uint32_t goal = m_goal_y * m_width + m_goal_x;
+            for( uint32_t index = goal; m_storage.node( index ).parent != no_parent; index = m_storage.node( index ).parent )
+            {
+                const uint32_t parent = m_storage.node( index ).parent;
+                int x = index % m_width;
+                int y = index / m_width;
+                const int parent_x = parent % m_width;
+                const int parent_y = parent / m_width;
+                const int dx = (parent_x > x) - (parent_x < x);
+                const int dy = (parent_y > y) - (parent_y < y);
+
+                for( ; x != parent_x || y != parent_y; x += dx, y += dy )
+                    o_path.push_back( y * m_width + x );
+            }
+        }
+};
+
+AStarAlgorithm::AStarAlgorithm( const bool use_jump_points ) :
+    m_use_jump_points( use_jump_points ),
+    m_has_path( false ),
+    m_path_goal_x( 0 ),
+    m_path_goal_y( 0 ),
+    m_has_failed( false ),
+    m_failed_from( 0 ),
+    m_failed_goal_x( 0 ),
+    m_failed_goal_y( 0 )
+{
+}
+
+AStarAlgorithm::~AStarAlgorithm()
+{
+}
+
+void AStarAlgorithm::initialize( const Robot& robot )
+{
+    m_path.clear();
+    m_has_path = false;
+    m_has_failed = false;
+    m_search.reset();
+}
+
+/*
+ * Other robots moving in view change the robot's knowledge nearly every
+ * tick, and it mustn't wait on a search which is thrown away just as
+ * often, so only a new wall next to a block the search has reached makes
+ * what it has gone through so far not hold anymore. A wall which is gone
+ * at most leaves a longer way than there is, which is fine. Jump points
+ * scan whole runs of blocks without reaching them, so with those any new
+ * wall does.
+ */
+bool AStarAlgorithm::is_search_outdated( const Robot& robot ) const
+{
+    if( robot.has_lost_knowledge_changes() )
+        return true;
+
+    const TiledArray2d< ObstacleType >& map = robot.obstacle_map();
+    for( const auto& change: robot.knowledge_changes() )
+    {
+        if( map.at( change.first, change.second ) != ObstacleType::Wall )
+            continue;
+
+        if( m_use_jump_points || m_search->has_reached_around( change.first, change.second, map.width(), map.height() ) )
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * A search which doesn't fit into the budget is started over in storage
+ * of its own, which it keeps while it's suspended; that throws away at
+ * most one budget's worth of work, while the searches which do fit, by
+ * far the most, keep using the much faster arena.
+ */
+bool AStarAlgorithm::plan( const Robot& robot )
+{
+    const uint32_t here = robot.y() * robot.obstacle_map().width() + robot.x();
+
+    /* Nothing can change until the robot either moves or learns about something new, which it does by moving. */
+    if( m_has_failed && m_failed_from == here && m_failed_goal_x == robot.goal_x() && m_failed_goal_y == robot.goal_y() )
+        return false;
+
+    if( m_search && (m_search->start != here || m_search->goal_x != robot.goal_x() || m_search->goal_y != robot.goal_y() || is_search_outdated( robot )) )
+        m_search.reset();
+
+    /* What's left of the budget, should the robot plan more than once in a run. */
+    std::size_t budget = planning_budget() - planning_spent();
+
+    SearchResult result;
+    if( m_search )
+    {
+        GridSearch< SuspendedSearch > search( *m_search, robot.obstacle_map(), robot.goal_x(), robot.goal_y() );
+        result = search.run( m_use_jump_points, budget );
+        if( result == SearchResult::Found )
+            search.trace( m_path );
+    }
+    else
+    {
+        GridSearch< SearchArena > search( arena, robot.obstacle_map(), robot.goal_x(), robot.goal_y() );
+        search.start( robot.x(), robot.y() );
+        result = search.run( m_use_jump_points, budget );
+        if( result == SearchResult::Found )
+            search.trace( m_path );
+        else if( result == SearchResult::OutOfBudget )
+        {
+            m_search.reset( new SuspendedSearch( here, robot.goal_x(), robot.goal_y() ) );
+            GridSearch< SuspendedSearch >( *m_search, robot.obstacle_map(), robot.goal_x(), robot.goal_y() ).start( robot.x(), robot.y() );
+        }
+    }
+
+    spend_planning_budget( planning_budget() - budget, result == SearchResult::OutOfBudget );
+    if( result == SearchResult::OutOfBudget )
+        return false;
+
+    m_search.reset();
+    m_has_path = result == SearchResult::Found;
+    if( !m_has_path )
+        m_path.clear();
+    m_path_goal_x = robot.goal_x();
+    m_path_goal_y = robot.goal_y();
+
+    m_has_failed = !m_has_path;
+    m_failed_from = here;
+    m_failed_goal_x = robot.goal_x();
+    m_failed_goal_y = robot.goal_y();
+
+    return m_has_path;
+}
+
+/*
+ * The robot only learns about new walls within its view, so only the
+ * part of the path in there has to be checked.
+ */
+bool AStarAlgorithm::is_path_blocked( const Robot& robot ) const
+{
+    const TiledArray2d< ObstacleType >& map = robot.obstacle_map();
+    const VisibilityWindow& view = robot.visibility_map();
+    const unsigned width = map.width();
+
+    for( auto i = m_path.rbegin(); i != m_path.rend(); ++i )
+    {
+        const unsigned x = *i % width;
+        const unsigned y = *i / width;
+        if( !view.contains( x, y ) )
+            break;
+
+        if( map.at( x, y ) == ObstacleType::Wall )
+            return true;
+    }
+
+    return false;
+}
+
+float AStarAlgorithm::run( const Robot& robot, const float elapsed )
+{
+    const unsigned width = robot.obstacle_map().width();
+    const uint32_t here = robot.y() * width + robot.x();
+
+    if( m_has_path && (m_path_goal_x != robot.goal_x() || m_path_goal_y != robot.goal_y()) )
+        m_has_path = false;
+
+    if( m_has_path )
+    {
+        while( !m_path.empty() && m_path.back() == here )
+            m_path.pop_back();
+
+        /* Pushed away from the path by someone else. */
+        if( !m_path.empty() )
+        {
+            const int next_x = m_path.back() % width;
+            const int next_y = m_path.back() / width;
+            if( std::abs( next_x - int( robot.x() ) ) > 1 || std::abs( next_y - int( robot.y() ) ) > 1 )
+                m_has_path = false;
+        }
+
+        if( m_has_path && is_path_blocked( robot ) )
+            m_has_path = false;
+    }
+
+    const float x = robot.x() + robot.frac_x();
+    const float y = robot.y() + robot.frac_y();
+
+    float target_x = robot.goal_x() + 0.5f;
+    float target_y = robot.goal_y() + 0.5f;
+
+    /* Without a path it's still better to head towards the goal than to stand still. */
+    if( m_has_path || plan( robot ) )
+    {
+        if( !m_path.empty() )
+        {
+            target_x = m_path.back() % width + 0.5f;
+            target_y = m_path.back() / width + 0.5f;
+        }
+    }
+    else if( m_search )
+    {
+        /* Still planning, which goes on from where the robot is, so it stays there. */
+        return NAN;
+    }
+
+    return atan2f( target_y - y, target_x - x );
+}
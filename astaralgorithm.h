@@ -0,0 +1,59 @@
+#ifndef ASTARALGORITHM_H
+#define ASTARALGORITHM_H
+
+#include "routingalgorithm.h"
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+struct SuspendedSearch;
+
+/**
+ * @brief Follows the shortest path to the goal through the blocks the
+ *        robot knows about, found with A*. The robot moves between the
+ *        eight neighbouring blocks but never cuts the corner of a wall;
+ *        blocks the robot has never seen are assumed to be free, and
+ *        other robots are ignored, since they move. The path is planned
+ *        again whenever the robot sees a wall on it.
+ *
+ * With jump points enabled the search skips over runs of blocks which
+ * can't lead anywhere new, which on open maps is a lot faster and still
+ * finds a path that is just as short.
+ *
+ * A search which goes through more blocks than the planning budget
+ * allows, counting the ones the jumps look at, is suspended, and carried
+ * on with in the following runs, while the robot waits where it is.
+ */
+class AStarAlgorithm : public RoutingAlgorithm
+{
+    bool m_use_jump_points;
+
+    /* The blocks left to go through, as y * width + x; the goal first and the next one last. */
+    std::vector< uint32_t > m_path;
+    bool m_has_path;
+    unsigned m_path_goal_x;
+    unsigned m_path_goal_y;
+
+    /* Where planning last failed, so that it isn't retried every tick. */
+    bool m_has_failed;
+    uint32_t m_failed_from;
+    unsigned m_failed_goal_x;
+    unsigned m_failed_goal_y;
+
+    /* The search still to be carried on with, if any. */
+    std::unique_ptr< SuspendedSearch > m_search;
+
+    bool is_search_outdated( const Robot& robot ) const;
+    bool plan( const Robot& robot );
+    bool is_path_blocked( const Robot& robot ) const;
+
+    public:
+        explicit AStarAlgorithm( const bool use_jump_points = false );
+        virtual ~AStarAlgorithm();
+
+        virtual void initialize( const Robot& robot ) override;
+        virtual float run( const Robot& robot, const float elapsed ) override;
+};
+
+#endif // ASTARALGORITHM_H
@@ -0,0 +1,661 @@
+#include "routingalgorithmregistry.h"
+#include "routingalgorithm.h"
+#include "scenewidget.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include "rendersnapshot.h"
+#include "scene.h"
+#include "robot.h"
+
+#include <QApplication>
+#include <QBuffer>
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+struct Options
+{
+    std::vector< unsigned > sizes = { 32, 128, 512, 1024, 2048, 4096 };
+    std::vector< unsigned > robot_counts = { 1, 10, 100, 1000, 10000, 100000 };
+    std::string filter;
+    std::string output_path;
+    std::string baseline_path;
+    double min_time = 0.2;
+    double threshold = 10.0;
+    double max_memory = 4.0 * 1024.0 * 1024.0 * 1024.0;
+    unsigned view_distance = 4;
+};
+
+struct Result
+{
+    std::string benchmark;
+    unsigned size;
+    unsigned robots;
+    unsigned long long iterations;
+    double ns_per_op;
+    std::string skipped;
+};
+
+static void print_usage( const char * program )
+{
+    fprintf( stderr,
+             "usage: %s [options]\n"
+             "\n"
+             "Times the simulation hot paths over a sweep of map sizes and robot counts.\n"
+             "\n"
+             "options:\n"
+             "  --filter <text>        run only benchmarks whose name contains <text>\n"
+             "  --sizes <list>         comma separated map sizes (default: 32,128,512,1024,2048,4096)\n"
+             "  --robots <list>        comma separated robot counts (default: 1,10,100,1000,10000,100000)\n"
+             "  --min-time <seconds>   minimum time spent measuring each case (default: 0.2)\n"
+             "  --max-memory <MiB>     skip cases whose scene would need more memory (default: 4096)\n"
+             "  --view-distance <n>    how far the robots can see, in blocks (default: 4)\n"
+             "  --output <file>        write the JSON results to <file> instead of stdout\n"
+             "  --compare <file>       compare against a baseline written by --output\n"
+             "  --threshold <percent>  slowdown reported as a regression by --compare (default: 10)\n",
+             program );
+}
+
+static bool parse_list( const char * text, std::vector< unsigned >& o_list )
+{
+    o_list.clear();
+    while( *text )
+    {
+        char * end;
+        const unsigned long value = strtoul( text, &end, 10 );
+        if( end == text || value == 0 )
+            return false;
+
+        o_list.push_back( value );
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    return !o_list.empty();
+}
+
+static int parse_options( int argc, char * argv[], Options& o_options )
+{
+    for( int i = 1; i < argc; ++i )
+    {
+        const char * arg = argv[ i ];
+        const bool has_value = i + 1 < argc;
+
+        if( strcmp( arg, "--help" ) == 0 || strcmp( arg, "-h" ) == 0 )
+        {
+            print_usage( argv[0] );
+            return -1;
+        }
+        else if( strcmp( arg, "--filter" ) == 0 && has_value )
+            o_options.filter = argv[ ++i ];
+        else if( strcmp( arg, "--output" ) == 0 && has_value )
+            o_options.output_path = argv[ ++i ];
+        else if( strcmp( arg, "--compare" ) == 0 && has_value )
+            o_options.baseline_path = argv[ ++i ];
+        else if( strcmp( arg, "--min-time" ) == 0 && has_value )
+            o_options.min_time = strtod( argv[ ++i ], nullptr );
+        else if( strcmp( arg, "--threshold" ) == 0 && has_value )
+            o_options.threshold = strtod( argv[ ++i ], nullptr );
+        else if( strcmp( arg, "--max-memory" ) == 0 && has_value )
+            o_options.max_memory = strtod( argv[ ++i ], nullptr ) * 1024.0 * 1024.0;
+        else if( strcmp( arg, "--view-distance" ) == 0 && has_value )
+            o_options.view_distance = strtoul( argv[ ++i ], nullptr, 10 );
+        else if( strcmp( arg, "--sizes" ) == 0 && has_value )
+        {
+            if( !parse_list( argv[ ++i ], o_options.sizes ) )
+            {
+                fprintf( stderr, "error: malformed list of sizes\n" );
+                return 1;
+            }
+        }
+        else if( strcmp( arg, "--robots" ) == 0 && has_value )
+        {
+            if( !parse_list( argv[ ++i ], o_options.robot_counts ) )
+            {
+                fprintf( stderr, "error: malformed list of robot counts\n" );
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf( stderr, "error: unknown or incomplete option '%s'\n", arg );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * A tiny deterministic generator so that every run
+ * benchmarks exactly the same scenes.
+ */
+class Random
+{
+    uint32_t m_state;
+
+    public:
+        explicit Random( const uint32_t seed ) : m_state( seed ) {}
+
+        unsigned next( const unsigned limit )
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return (m_state >> 8) % limit;
+        }
+};
+
+/*
+ * Rough amount of memory a scene needs; every robot carries
+ * a sparse obstacle map covering the area around itself.
+ */
+static double estimate_scene_memory( const unsigned size, const unsigned robots )
+{
+    const double cells = double( size ) * size;
+    return cells * (1.0 + sizeof( Robot * )) + double( robots ) * (cells / 8192.0 + 16384.0);
+}
+
+static std::shared_ptr< Scene > create_scene( const unsigned size, const unsigned robots, const unsigned view_distance )
+{
+    std::shared_ptr< Scene > scene = std::make_shared< Scene >( size, size );
+    scene->set_view_distance( view_distance );
+    Random random( size * 7919u + robots );
+
+    /* Cover roughly a tenth of the map with walls. */
+    const unsigned long long walls = (unsigned long long)size * size / 10;
+    for( unsigned long long i = 0; i < walls; ++i )
+        scene->add_wall( random.next( size ), random.next( size ) );
+
+    for( unsigned i = 0; i < robots; ++i )
+    {
+        unsigned x, y;
+        do
+        {
+            x = random.next( size );
+            y = random.next( size );
+        } while( scene->is_blocked( x, y ) );
+
+        Robot& robot = scene->add_robot( x, y );
+        robot.set_goal( random.next( size ), random.next( size ) );
+    }
+
+    scene->update_visibility();
+    return scene;
+}
+
+/*
+ * Runs @a op repeatedly for at least @a min_time seconds
+ * and returns the average time it took, in nanoseconds.
+ */
+static double measure( const double min_time, unsigned long long& o_iterations, const std::function< void () >& op )
+{
+    const qint64 min_nsecs = qint64( min_time * 1000000000.0 );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    o_iterations = 0;
+    qint64 elapsed;
+    do
+    {
+        op();
+        o_iterations++;
+        elapsed = timer.nsecsElapsed();
+    } while( elapsed < min_nsecs );
+
+    return double( elapsed ) / double( o_iterations );
+}
+
+typedef std::function< double ( Scene& scene, double min_time, unsigned long long& o_iterations ) > BenchmarkFunction;
+
+static double bench_visibility( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    auto i = scene.robot_list().begin();
+    return measure( min_time, o_iterations, [&]() {
+        scene.calculate_visibility_for( *i );
+        if( ++i == scene.robot_list().end() )
+            i = scene.robot_list().begin();
+    });
+}
+
+static double bench_visibility_all_robots( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    ThreadPool thread_pool;
+    return measure( min_time, o_iterations, [&]() {
+        scene.invalidate_visibility();
+        scene.update_visibility( &thread_pool );
+    });
+}
+
+static double bench_visibility_raymarching( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    scene.set_visibility_algorithm( VisibilityAlgorithm::RayMarching );
+    return bench_visibility( scene, min_time, o_iterations );
+}
+
+static double run_simulation_ticks( Scene& scene, const unsigned threads, const bool is_specialized, const double min_time, unsigned long long& o_iterations )
+{
+    auto factory_method = RoutingAlgorithmRegistry::instance().algorithm_map().find( "Dummy" );
+    assert( factory_method != RoutingAlgorithmRegistry::instance().algorithm_map().end() );
+
+    for( Robot& robot: scene.robot_list() )
+        robot.set_routing_algorithm( factory_method->second() );
+
+    /* The simulation needs a shared handle; the scene outlives it. */
+    const std::shared_ptr< Scene > handle( &scene, []( Scene * ) {} );
+    std::unique_ptr< Simulation > simulation;
+    if( is_specialized )
+        simulation = RoutingAlgorithmRegistry::instance().instantiate_simulation( "Dummy", handle );
+    else
+        simulation.reset( new Simulation( handle ) );
+
+    simulation->set_thread_count( threads );
+
+    return measure( min_time, o_iterations, [&]() {
+        simulation->run( 0.01f );
+    });
+}
+
+static double bench_simulation_tick( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    return run_simulation_ticks( scene, 0, false, min_time, o_iterations );
+}
+
+static double bench_simulation_tick_specialized( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    return run_simulation_ticks( scene, 0, true, min_time, o_iterations );
+}
+
+static double bench_simulation_tick_serial( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    return run_simulation_ticks( scene, 1, false, min_time, o_iterations );
+}
+
+static double bench_get_robot( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    std::vector< std::pair< unsigned, unsigned > > positions;
+    for( const Robot& robot: scene.robot_list() )
+        positions.push_back( std::make_pair( robot.x(), robot.y() ) );
+
+    std::size_t index = 0;
+    const Robot * volatile sink = nullptr;
+
+    const double ns_per_op = measure( min_time, o_iterations, [&]() {
+        sink = scene.get_robot( positions[ index ].first, positions[ index ].second );
+        index = (index + 1) % positions.size();
+    });
+
+    (void)sink;
+    return ns_per_op;
+}
+
+static double bench_add_remove_robot( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    std::vector< std::pair< unsigned, unsigned > > free_cells;
+    Random random( 1 );
+    while( free_cells.size() < 64 )
+    {
+        const unsigned x = random.next( scene.width() );
+        const unsigned y = random.next( scene.height() );
+        if( !scene.is_blocked( x, y ) )
+            free_cells.push_back( std::make_pair( x, y ) );
+    }
+
+    std::size_t index = 0;
+    return measure( min_time, o_iterations, [&]() {
+        const auto& cell = free_cells[ index ];
+        if( !scene.is_blocked( cell.first, cell.second ) )
+            scene.remove_robot( scene.add_robot( cell.first, cell.second ) );
+
+        index = (index + 1) % free_cells.size();
+    });
+}
+
+static double bench_is_area_empty( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    std::vector< std::pair< unsigned, unsigned > > corners;
+    Random random( 2 );
+    for( unsigned i = 0; i < 64; ++i )
+        corners.push_back( std::make_pair( random.next( scene.width() ), random.next( scene.height() ) ) );
+
+    std::size_t index = 0;
+    volatile bool sink = false;
+
+    const double ns_per_op = measure( min_time, o_iterations, [&]() {
+        sink = scene.wall_pyramid().is_area_empty( corners[ index ].first, corners[ index ].second, 64, 64 );
+        index = (index + 1) % corners.size();
+    });
+
+    (void)sink;
+    return ns_per_op;
+}
+
+static double bench_is_area_free( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    std::vector< std::pair< unsigned, unsigned > > corners;
+    Random random( 4 );
+    for( unsigned i = 0; i < 64; ++i )
+        corners.push_back( std::make_pair( random.next( scene.width() ), random.next( scene.height() ) ) );
+
+    std::size_t index = 0;
+    volatile bool sink = false;
+
+    /* Small enough to be free now and then among the walls, which is when the whole of it has to be looked at. */
+    const double ns_per_op = measure( min_time, o_iterations, [&]() {
+        sink = scene.is_area_free( corners[ index ].first, corners[ index ].second, 4, 4 );
+        index = (index + 1) % corners.size();
+    });
+
+    (void)sink;
+    return ns_per_op;
+}
+
+static double bench_count_obstacles( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    std::vector< std::pair< unsigned, unsigned > > corners;
+    Random random( 5 );
+    for( unsigned i = 0; i < 64; ++i )
+        corners.push_back( std::make_pair( random.next( scene.width() ), random.next( scene.height() ) ) );
+
+    std::size_t index = 0;
+    volatile unsigned sink = 0;
+
+    const double ns_per_op = measure( min_time, o_iterations, [&]() {
+        sink = scene.count_obstacles( corners[ index ].first, corners[ index ].second, 64, 64 );
+        index = (index + 1) % corners.size();
+    });
+
+    (void)sink;
+    return ns_per_op;
+}
+
+static double bench_line_of_sight( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    /* Lines as long as the robots can see, in every direction. */
+    std::vector< std::pair< unsigned, unsigned > > points;
+    Random random( 6 );
+    while( points.size() < 128 )
+    {
+        const unsigned x = random.next( scene.width() );
+        const unsigned y = random.next( scene.height() );
+        points.push_back( std::make_pair( x, y ) );
+
+        const int distance = scene.view_distance();
+        const int other_x = std::min( std::max( int( x ) + int( random.next( 2 * distance + 1 ) ) - distance, 0 ), int( scene.width() ) - 1 );
+        const int other_y = std::min( std::max( int( y ) + int( random.next( 2 * distance + 1 ) ) - distance, 0 ), int( scene.height() ) - 1 );
+        points.push_back( std::make_pair( other_x, other_y ) );
+    }
+
+    std::size_t index = 0;
+    volatile bool sink = false;
+
+    const double ns_per_op = measure( min_time, o_iterations, [&]() {
+        sink = scene.has_line_of_sight( points[ index ].first, points[ index ].second, points[ index + 1 ].first, points[ index + 1 ].second );
+        index = (index + 2) % points.size();
+    });
+
+    (void)sink;
+    return ns_per_op;
+}
+
+static double bench_cluster_path( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    /* Built up front; only the searches are timed. */
+    const ClusterGraph& graph = scene.cluster_graph();
+
+    std::vector< std::pair< unsigned, unsigned > > points;
+    Random random( 3 );
+    while( points.size() < 64 )
+    {
+        const unsigned x = random.next( scene.width() );
+        const unsigned y = random.next( scene.height() );
+        if( !scene.wall_plane().get( x, y ) )
+            points.push_back( std::make_pair( x, y ) );
+    }
+
+    std::vector< uint32_t > waypoints;
+    std::size_t index = 0;
+
+    return measure( min_time, o_iterations, [&]() {
+        const std::pair< unsigned, unsigned >& start = points[ index ];
+        const std::pair< unsigned, unsigned >& goal = points[ (index + 1) % points.size() ];
+        graph.find_path( start.first, start.second, goal.first, goal.second, waypoints );
+        index = (index + 1) % points.size();
+    });
+}
+
+static double bench_serialize( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    QByteArray data;
+    return measure( min_time, o_iterations, [&]() {
+        data.clear();
+        QBuffer buffer( &data );
+        buffer.open( QIODevice::WriteOnly );
+        QDataStream stream( &buffer );
+        scene.serialize( stream );
+    });
+}
+
+static double bench_deserialize( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    QByteArray data;
+    {
+        QBuffer buffer( &data );
+        buffer.open( QIODevice::WriteOnly );
+        QDataStream stream( &buffer );
+        scene.serialize( stream );
+    }
+
+    Scene target( 1, 1 );
+    return measure( min_time, o_iterations, [&]() {
+        QBuffer buffer( &data );
+        buffer.open( QIODevice::ReadOnly );
+        QDataStream stream( &buffer );
+        target.deserialize( stream );
+    });
+}
+
+static double bench_paint( Scene& scene, const double min_time, unsigned long long& o_iterations )
+{
+    RenderSnapshot snapshot;
+    snapshot.capture( scene, nullptr, false );
+
+    SceneWidget widget;
+    widget.set_snapshot( snapshot );
+    widget.resize( 1024, 768 );
+
+    QImage image( widget.size(), QImage::Format_ARGB32_Premultiplied );
+    return measure( min_time, o_iterations, [&]() {
+        widget.render( &image );
+    });
+}
+
+static QJsonObject to_json( const Result& result )
+{
+    QJsonObject object;
+    object[ "benchmark" ] = QString::fromStdString( result.benchmark );
+    object[ "size" ] = double( result.size );
+    object[ "robots" ] = double( result.robots );
+
+    if( result.skipped.empty() )
+    {
+        object[ "iterations" ] = double( result.iterations );
+        object[ "ns_per_op" ] = result.ns_per_op;
+    }
+    else
+        object[ "skipped" ] = QString::fromStdString( result.skipped );
+
+    return object;
+}
+
+static std::string result_key( const std::string& benchmark, const unsigned size, const unsigned robots )
+{
+    return benchmark + "/" + std::to_string( size ) + "/" + std::to_string( robots );
+}
+
+/*
+ * @return Number of regressions found, or -1 if the baseline couldn't be read.
+ */
+static int compare_with_baseline( const std::vector< Result >& results, const Options& options )
+{
+    QFile fp( QString::fromLocal8Bit( options.baseline_path.c_str() ) );
+    if( !fp.open( QIODevice::ReadOnly ) )
+        return -1;
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson( fp.readAll(), &error );
+    if( error.error != QJsonParseError::NoError || !document.isObject() )
+        return -1;
+
+    std::map< std::string, double > baseline;
+    for( const QJsonValue value: document.object()[ "results" ].toArray() )
+    {
+        const QJsonObject object = value.toObject();
+        if( !object.contains( "ns_per_op" ) )
+            continue;
+
+        const std::string key = result_key( object[ "benchmark" ].toString().toStdString(),
+                                            object[ "size" ].toInt(),
+                                            object[ "robots" ].toInt() );
+        baseline[ key ] = object[ "ns_per_op" ].toDouble();
+    }
+
+    int regressions = 0;
+    for( const Result& result: results )
+    {
+        if( !result.skipped.empty() )
+            continue;
+
+        auto i = baseline.find( result_key( result.benchmark, result.size, result.robots ) );
+        if( i == baseline.end() || i->second <= 0.0 )
+            continue;
+
+        const double change = (result.ns_per_op / i->second - 1.0) * 100.0;
+        const bool regressed = change > options.threshold;
+        if( regressed )
+            regressions++;
+
+        fprintf( stderr, "%-24s %5ux%-5u %6u robots  %14.1f ns -> %14.1f ns  %+7.1f%%%s\n",
+                 result.benchmark.c_str(), result.size, result.size, result.robots,
+                 i->second, result.ns_per_op, change, regressed ? "  REGRESSION" : "" );
+    }
+
+    return regressions;
+}
+
+int main( int argc, char * argv[] )
+{
+    Options options;
+    const int status = parse_options( argc, argv, options );
+    if( status != 0 )
+        return status < 0 ? 0 : status;
+
+    /* Painting happens into an image; there's no need for a display. */
+    if( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+        qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    QApplication application( argc, argv );
+
+    const std::vector< std::pair< std::string, BenchmarkFunction > > benchmarks = {
+        { "visibility", bench_visibility },
+        { "visibility_all_robots", bench_visibility_all_robots },
+        { "visibility_raymarching", bench_visibility_raymarching },
+        { "simulation_tick", bench_simulation_tick },
+        { "simulation_tick_specialized", bench_simulation_tick_specialized },
+        { "simulation_tick_serial", bench_simulation_tick_serial },
+        { "get_robot", bench_get_robot },
+        { "add_remove_robot", bench_add_remove_robot },
+        { "is_area_empty", bench_is_area_empty },
+        { "is_area_free", bench_is_area_free },
+        { "count_obstacles", bench_count_obstacles },
+        { "line_of_sight", bench_line_of_sight },
+        { "cluster_path", bench_cluster_path },
+        { "serialize", bench_serialize },
+        { "deserialize", bench_deserialize },
+        { "paint", bench_paint }
+    };
+
+    std::vector< Result > results;
+    for( const unsigned size: options.sizes )
+    {
+        for( const unsigned robots: options.robot_counts )
+        {
+            std::string skipped;
+            if( (unsigned long long)robots * 4 > (unsigned long long)size * size )
+                skipped = "too many robots for the map";
+            else if( estimate_scene_memory( size, robots ) > options.max_memory )
+                skipped = "exceeds memory limit";
+
+            std::shared_ptr< Scene > scene;
+            for( const auto& benchmark: benchmarks )
+            {
+                if( benchmark.first.find( options.filter ) == std::string::npos )
+                    continue;
+
+                Result result = { benchmark.first, size, robots, 0, 0.0, skipped };
+                if( skipped.empty() )
+                {
+                    /* Benchmarks may modify the scene, so each one gets a fresh copy. */
+                    scene = create_scene( size, robots, options.view_distance );
+                    result.ns_per_op = benchmark.second( *scene, options.min_time, result.iterations );
+                    fprintf( stderr, "%-24s %5ux%-5u %6u robots  %14.1f ns/op\n",
+                             result.benchmark.c_str(), size, size, robots, result.ns_per_op );
+                }
+
+                results.push_back( result );
+            }
+        }
+    }
+
+    QJsonArray array;
+    for( const Result& result: results )
+        array.append( to_json( result ) );
+
+    QJsonObject root;
+    root[ "version" ] = 1;
+    root[ "results" ] = array;
+
+    const QByteArray json = QJsonDocument( root ).toJson();
+    if( options.output_path.empty() )
+        fwrite( json.constData(), 1, json.size(), stdout );
+    else
+    {
+        QFile fp( QString::fromLocal8Bit( options.output_path.c_str() ) );
+        if( !fp.open( QIODevice::WriteOnly ) )
+        {
+            fprintf( stderr, "error: failed to open '%s' for writing\n", options.output_path.c_str() );
+            return 1;
+        }
+
+        fp.write( json );
+    }
+
+    if( !options.baseline_path.empty() )
+    {
+        const int regressions = compare_with_baseline( results, options );
+        if( regressions < 0 )
+        {
+            fprintf( stderr, "error: failed to read the baseline from '%s'\n", options.baseline_path.c_str() );
+            return 1;
+        }
+
+        fprintf( stderr, "%d regression(s) above %.1f%%\n", regressions, options.threshold );
+        if( regressions > 0 )
+            return 2;
+    }
+
+    return 0;
+}
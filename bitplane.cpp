@@ -0,0 +1,125 @@
+#include "bitplane.h"
+
+#include <assert.h>
+#include <algorithm>
+
+static unsigned population_count( const uint64_t word )
+{
+    #if defined( __GNUC__ )
+        return __builtin_popcountll( word );
+    #else
+        uint64_t x = word - ((word >> 1) & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return (x * 0x0101010101010101ull) >> 56;
+    #endif
+}
+
+BitPlane::BitPlane( const unsigned width, const unsigned height ) :
+    m_width( width ),
+    m_height( height ),
+    m_words_per_row( (width + 63) / 64 ),
+    m_words( std::size_t( m_words_per_row ) * height, 0 )
+{
+}
+
+unsigned BitPlane::width() const
+{
+    return m_width;
+}
+
+unsigned BitPlane::height() const
+{
+    return m_height;
+}
+
+unsigned BitPlane::words_per_row() const
+{
+    return m_words_per_row;
+}
+
+const uint64_t * BitPlane::row( const unsigned y ) const
+{
+    assert( y < m_height );
+    return m_words.data() + std::size_t( y ) * m_words_per_row;
+}
+
+void BitPlane::clear()
+{
+    std::fill( m_words.begin(), m_words.end(), 0 );
+}
+
+bool BitPlane::any_in_row( const unsigned y, const unsigned x_begin, const unsigned x_end ) const
+{
+    assert( x_begin <= x_end );
+    assert( x_end < m_width );
+
+    const uint64_t * words = row( y );
+    const unsigned first = x_begin >> 6;
+    const unsigned last = x_end >> 6;
+    const uint64_t first_mask = ~uint64_t( 0 ) << (x_begin & 63);
+    const uint64_t last_mask = ~uint64_t( 0 ) >> (63 - (x_end & 63));
+
+    if( first == last )
+        return (words[ first ] & first_mask & last_mask) != 0;
+
+    /* A branchless loop, so that the compiler can vectorize it. */
+    uint64_t accumulator = (words[ first ] & first_mask) | (words[ last ] & last_mask);
+    for( unsigned i = first + 1; i < last; ++i )
+        accumulator |= words[ i ];
+
+    return accumulator != 0;
+}
+
+unsigned BitPlane::count_in_row( const unsigned y, const unsigned x_begin, const unsigned x_end ) const
+{
+    assert( x_begin <= x_end );
+    assert( x_end < m_width );
+
+    const uint64_t * words = row( y );
+    const unsigned first = x_begin >> 6;
+    const unsigned last = x_end >> 6;
+    const uint64_t first_mask = ~uint64_t( 0 ) << (x_begin & 63);
+    const uint64_t last_mask = ~uint64_t( 0 ) >> (63 - (x_end & 63));
+
+    if( first == last )
+        return population_count( words[ first ] & first_mask & last_mask );
+
+    unsigned count = population_count( words[ first ] & first_mask ) + population_count( words[ last ] & last_mask );
+    for( unsigned i = first + 1; i < last; ++i )
+        count += population_count( words[ i ] );
+
+    return count;
+}
+
+bool BitPlane::any( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    if( width == 0 || height == 0 )
+        return false;
+
+    assert( x + width <= m_width );
+    assert( y + height <= m_height );
+
+    for( unsigned i = y; i < y + height; ++i )
+    {
+        if( any_in_row( i, x, x + width - 1 ) )
+            return true;
+    }
+
+    return false;
+}
+
+unsigned BitPlane::count( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    if( width == 0 || height == 0 )
+        return 0;
+
+    assert( x + width <= m_width );
+    assert( y + height <= m_height );
+
+    unsigned count = 0;
+    for( unsigned i = y; i < y + height; ++i )
+        count += count_in_row( i, x, x + width - 1 );
+
+    return count;
+}
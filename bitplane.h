@@ -0,0 +1,91 @@
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief A two dimensional array of bits, packed 64 per word with
+ *        every row starting at a word boundary, so that whole runs
+ *        of blocks can be tested with a handful of word operations.
+ */
+class BitPlane
+{
+    unsigned m_width;
+    unsigned m_height;
+    unsigned m_words_per_row;
+
+    std::vector< uint64_t > m_words;
+
+    public:
+        explicit BitPlane( const unsigned width, const unsigned height );
+
+        /**
+         * @return Width of the plane.
+         */
+        unsigned width() const;
+
+        /**
+         * @return Height of the plane.
+         */
+        unsigned height() const;
+
+        /**
+         * @return Number of words every row is made of.
+         */
+        unsigned words_per_row() const;
+
+        /**
+         * @return Pointer to the first word of a given row.
+         */
+        const uint64_t * row( const unsigned y ) const;
+
+        /**
+         * @return The bit at given point.
+         */
+        bool get( const unsigned x, const unsigned y ) const
+        {
+            return (m_words[ y * m_words_per_row + (x >> 6) ] >> (x & 63)) & 1;
+        }
+
+        /**
+         * @brief Sets the bit at given point.
+         */
+        void set( const unsigned x, const unsigned y, const bool value )
+        {
+            uint64_t& word = m_words[ y * m_words_per_row + (x >> 6) ];
+            const uint64_t mask = uint64_t( 1 ) << (x & 63);
+
+            if( value )
+                word |= mask;
+            else
+                word &= ~mask;
+        }
+
+        /**
+         * @brief Clears every bit.
+         */
+        void clear();
+
+        /**
+         * @return Whenever any bit between x_begin and x_end, inclusive, is set in a given row.
+         */
+        bool any_in_row( const unsigned y, const unsigned x_begin, const unsigned x_end ) const;
+
+        /**
+         * @return Number of bits set between x_begin and x_end, inclusive, in a given row.
+         */
+        unsigned count_in_row( const unsigned y, const unsigned x_begin, const unsigned x_end ) const;
+
+        /**
+         * @return Whenever any bit is set in a given rectangle, which must lie inside of the plane.
+         */
+        bool any( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const;
+
+        /**
+         * @return Number of bits set in a given rectangle, which must lie inside of the plane.
+         */
+        unsigned count( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const;
+};
+
+#endif // BITPLANE_H
@@ -0,0 +1,120 @@
+#ifndef BUCKETGRID_H
+#define BUCKETGRID_H
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+/**
+ * @brief Finds the items lying within a rectangle of a map.
+ *
+ * The map is split into square buckets of 16x16 blocks and the indices
+ * of the items are sorted by the bucket they're in, so that the items
+ * near a rectangle can be found without looking at every single one.
+ * It's meant to be rebuilt from scratch whenever the items move.
+ */
+class BucketGrid
+{
+    public:
+        static const unsigned bucket_shift = 4;
+        static const unsigned bucket_size = 1 << bucket_shift;
+
+    private:
+        unsigned m_columns;
+        unsigned m_rows;
+
+        /* Items of bucket i are m_items[ m_offsets[ i ] ] to m_items[ m_offsets[ i + 1 ] - 1 ]. */
+        std::vector< unsigned > m_offsets;
+        std::vector< unsigned > m_items;
+        std::vector< unsigned > m_item_buckets;
+
+    public:
+        explicit BucketGrid() :
+            m_columns( 0 ),
+            m_rows( 0 )
+        {
+        }
+
+        /**
+         * @brief Sorts the items 0 to @a count - 1 into buckets.
+         * @param position Called as position( index, o_x, o_y ) for every
+         *        item; returns whenever the item is to be put into the grid
+         *        at all, and if so sets its block's coordinates, which have
+         *        to lie within the map.
+         */
+        template < typename position_t >
+        void build( const unsigned width, const unsigned height, const std::size_t count, position_t position )
+        {
+            m_columns = (width + bucket_size - 1) >> bucket_shift;
+            m_rows = (height + bucket_size - 1) >> bucket_shift;
+
+            const std::size_t bucket_count = std::size_t( m_columns ) * m_rows;
+            const unsigned none = ~0u;
+
+            m_offsets.assign( bucket_count + 1, 0 );
+            m_item_buckets.resize( count );
+
+            /* A counting sort: count the items per bucket, turn that into offsets, then place them. */
+            for( std::size_t i = 0; i < count; ++i )
+            {
+                unsigned x, y;
+                if( !position( i, x, y ) )
+                {
+                    m_item_buckets[ i ] = none;
+                    continue;
+                }
+
+                assert( x < width && y < height );
+
+                const unsigned bucket = (y >> bucket_shift) * m_columns + (x >> bucket_shift);
+                m_item_buckets[ i ] = bucket;
+                m_offsets[ bucket + 1 ]++;
+            }
+
+            for( std::size_t i = 0; i < bucket_count; ++i )
+                m_offsets[ i + 1 ] += m_offsets[ i ];
+
+            m_items.resize( m_offsets[ bucket_count ] );
+            for( std::size_t i = 0; i < count; ++i )
+            {
+                const unsigned bucket = m_item_buckets[ i ];
+                if( bucket != none )
+                    m_items[ m_offsets[ bucket ]++ ] = i;
+            }
+
+            /* Placing the items moved every offset onto the start of the next bucket. */
+            for( std::size_t i = bucket_count; i > 0; --i )
+                m_offsets[ i ] = m_offsets[ i - 1 ];
+
+            m_offsets[ 0 ] = 0;
+        }
+
+        /**
+         * @brief Calls @a callback with the index of every item in a bucket
+         *        which overlaps the blocks [min_x, max_x) x [min_y, max_y),
+         *        so it also gets some of the items just outside of it.
+         */
+        template < typename callback_t >
+        void for_each_near( const unsigned min_x, const unsigned min_y, const unsigned max_x, const unsigned max_y, callback_t callback ) const
+        {
+            if( min_x >= max_x || min_y >= max_y )
+                return;
+
+            const unsigned min_column = std::min( min_x >> bucket_shift, m_columns );
+            const unsigned min_row = std::min( min_y >> bucket_shift, m_rows );
+            const unsigned max_column = std::min( ((max_x - 1) >> bucket_shift) + 1, m_columns );
+            const unsigned max_row = std::min( ((max_y - 1) >> bucket_shift) + 1, m_rows );
+
+            for( unsigned row = min_row; row < max_row; ++row )
+            {
+                const std::size_t first = m_offsets[ row * m_columns + min_column ];
+                const std::size_t last = m_offsets[ row * m_columns + max_column ];
+
+                /* The buckets in a row are next to each other, and so are their items. */
+                for( std::size_t i = first; i < last; ++i )
+                    callback( m_items[ i ] );
+            }
+        }
+};
+
+#endif // BUCKETGRID_H
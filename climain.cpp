@@ -0,0 +1,254 @@
+#include "routingalgorithmregistry.h"
+#include "routingalgorithm.h"
+#include "simulation.h"
+#include "scene.h"
+#include "robot.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+struct Options
+{
+    std::string scene_path;
+    std::string algorithm = "Dummy";
+    float timestep = 0.01f;
+    unsigned long long max_ticks = 100000;
+    unsigned view_distance = 0;
+    unsigned threads = 0;
+    bool is_generic = false;
+    std::size_t planning_budget = RoutingAlgorithm::unlimited_budget;
+    VisibilityAlgorithm visibility_algorithm = VisibilityAlgorithm::Shadowcasting;
+};
+
+static void print_usage( const char * program )
+{
+    fprintf( stderr,
+             "usage: %s [options] <scene file>\n"
+             "\n"
+             "Runs the simulation without a GUI as fast as possible.\n"
+             "\n"
+             "options:\n"
+             "  --algorithm <name>     routing algorithm to use (default: Dummy)\n"
+             "  --timestep <seconds>   fixed simulation timestep (default: 0.01)\n"
+             "  --max-ticks <count>    stop after this many ticks; 0 means no limit (default: 100000)\n"
+             "  --view-distance <n>    how far the robots can see, in blocks (default: 4)\n"
+             "  --visibility <name>    field of view algorithm: shadowcasting or raymarching\n"
+             "                         (default: shadowcasting)\n"
+             "  --threads <count>      threads used to run the simulation; 0 uses every\n"
+             "                         hardware thread (default: 0)\n"
+             "  --planning-budget <n>  most nodes the robots' searches may go through in a\n"
+             "                         single tick, all together (default: no limit)\n"
+             "  --generic              don't use a simulation specialized for the algorithm,\n"
+             "                         even if it has one; the results are the same\n"
+             "  --list-algorithms      print the available routing algorithms and exit\n",
+             program );
+}
+
+static void print_algorithms()
+{
+    for( auto& pair: RoutingAlgorithmRegistry::instance().algorithm_map() )
+        printf( "%s\n", pair.first.c_str() );
+}
+
+/*
+ * Returns 0 on success, 1 on a malformed command line
+ * and -1 when the program should exit successfully.
+ */
+static int parse_options( int argc, char * argv[], Options& o_options )
+{
+    for( int i = 1; i < argc; ++i )
+    {
+        const char * arg = argv[ i ];
+        const bool has_value = i + 1 < argc;
+
+        if( strcmp( arg, "--help" ) == 0 || strcmp( arg, "-h" ) == 0 )
+        {
+            print_usage( argv[0] );
+            return -1;
+        }
+        else if( strcmp( arg, "--list-algorithms" ) == 0 )
+        {
+            print_algorithms();
+            return -1;
+        }
+        else if( strcmp( arg, "--planning-budget" ) == 0 && has_value )
+        {
+            o_options.planning_budget = strtoull( argv[ ++i ], nullptr, 10 );
+            if( o_options.planning_budget == 0 )
+            {
+                fprintf( stderr, "error: the planning budget must be positive\n" );
+                return 1;
+            }
+        }
+        else if( strcmp( arg, "--generic" ) == 0 )
+        {
+            o_options.is_generic = true;
+        }
+        else if( strcmp( arg, "--algorithm" ) == 0 && has_value )
+        {
+            o_options.algorithm = argv[ ++i ];
+        }
+        else if( strcmp( arg, "--timestep" ) == 0 && has_value )
+        {
+            o_options.timestep = strtof( argv[ ++i ], nullptr );
+            if( !(o_options.timestep > 0.0f) )
+            {
+                fprintf( stderr, "error: the timestep must be positive\n" );
+                return 1;
+            }
+        }
+        else if( strcmp( arg, "--max-ticks" ) == 0 && has_value )
+        {
+            o_options.max_ticks = strtoull( argv[ ++i ], nullptr, 10 );
+        }
+        else if( strcmp( arg, "--view-distance" ) == 0 && has_value )
+        {
+            o_options.view_distance = strtoul( argv[ ++i ], nullptr, 10 );
+            if( o_options.view_distance == 0 )
+            {
+                fprintf( stderr, "error: the view distance must be positive\n" );
+                return 1;
+            }
+        }
+        else if( strcmp( arg, "--threads" ) == 0 && has_value )
+        {
+            o_options.threads = strtoul( argv[ ++i ], nullptr, 10 );
+        }
+        else if( strcmp( arg, "--visibility" ) == 0 && has_value )
+        {
+            const char * name = argv[ ++i ];
+            if( strcmp( name, "shadowcasting" ) == 0 )
+                o_options.visibility_algorithm = VisibilityAlgorithm::Shadowcasting;
+            else if( strcmp( name, "raymarching" ) == 0 )
+                o_options.visibility_algorithm = VisibilityAlgorithm::RayMarching;
+            else
+            {
+                fprintf( stderr, "error: unknown visibility algorithm '%s'\n", name );
+                return 1;
+            }
+        }
+        else if( arg[0] == '-' )
+        {
+            fprintf( stderr, "error: unknown or incomplete option '%s'\n", arg );
+            return 1;
+        }
+        else if( o_options.scene_path.empty() )
+        {
+            o_options.scene_path = arg;
+        }
+        else
+        {
+            fprintf( stderr, "error: only one scene file can be given\n" );
+            return 1;
+        }
+    }
+
+    if( o_options.scene_path.empty() )
+    {
+        print_usage( argv[0] );
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool load( const std::string& path, Scene& scene )
+{
+    QFile fp( QString::fromLocal8Bit( path.c_str() ) );
+    if( !fp.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream stream( &fp );
+    return scene.deserialize( stream );
+}
+
+static unsigned count_robots_with_goal( const Scene& scene )
+{
+    unsigned count = 0;
+    for( const Robot& robot: scene.robot_list() )
+    {
+        if( robot.has_goal() )
+            count++;
+    }
+
+    return count;
+}
+
+int main( int argc, char * argv[] )
+{
+    Options options;
+    const int status = parse_options( argc, argv, options );
+    if( status != 0 )
+        return status < 0 ? 0 : status;
+
+    auto factory_method = RoutingAlgorithmRegistry::instance().algorithm_map().find( options.algorithm );
+    if( factory_method == RoutingAlgorithmRegistry::instance().algorithm_map().end() )
+    {
+        fprintf( stderr, "error: unknown routing algorithm '%s'; available algorithms:\n", options.algorithm.c_str() );
+        for( auto& pair: RoutingAlgorithmRegistry::instance().algorithm_map() )
+            fprintf( stderr, "  %s\n", pair.first.c_str() );
+
+        return 1;
+    }
+
+    std::shared_ptr< Scene > scene = std::make_shared< Scene >( 1, 1 );
+    if( !load( options.scene_path, *scene ) )
+    {
+        fprintf( stderr, "error: failed to load scene from '%s'\n", options.scene_path.c_str() );
+        return 1;
+    }
+
+    if( options.view_distance > 0 )
+        scene->set_view_distance( options.view_distance );
+
+    scene->set_visibility_algorithm( options.visibility_algorithm );
+
+    /* Every robot gets the same algorithm, so a simulation specialized for it can be used. */
+    std::unique_ptr< Simulation > simulation;
+    if( options.is_generic )
+        simulation.reset( new Simulation( scene ) );
+    else
+        simulation = RoutingAlgorithmRegistry::instance().instantiate_simulation( options.algorithm, scene );
+
+    simulation->set_thread_count( options.threads );
+    simulation->set_planning_budget( options.planning_budget );
+    for( Robot& robot: scene->robot_list() )
+        robot.set_routing_algorithm( factory_method->second() );
+
+    const unsigned robot_count = scene->robot_list().size();
+    const unsigned initial_robots_with_goal = count_robots_with_goal( *scene );
+
+    unsigned robots_with_goal = initial_robots_with_goal;
+    unsigned long long ticks = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while( robots_with_goal > 0 && (options.max_ticks == 0 || ticks < options.max_ticks) )
+    {
+        simulation->run( options.timestep );
+        ticks++;
+
+        robots_with_goal = count_robots_with_goal( *scene );
+    }
+
+    const double wall_time = double( timer.nsecsElapsed() ) / 1000000000.0;
+    const double ticks_per_second = wall_time > 0.0 ? ticks / wall_time : 0.0;
+
+    printf( "scene:          %s (%ux%u, %u robots)\n", options.scene_path.c_str(), scene->width(), scene->height(), robot_count );
+    printf( "algorithm:      %s\n", options.algorithm.c_str() );
+    printf( "threads:        %u\n", simulation->thread_count() );
+    printf( "ticks:          %llu\n", ticks );
+    printf( "simulated time: %.3f s\n", ticks * double( options.timestep ) );
+    printf( "wall time:      %.3f s\n", wall_time );
+    printf( "ticks/sec:      %.1f\n", ticks_per_second );
+    printf( "robots arrived: %u/%u\n", initial_robots_with_goal - robots_with_goal, initial_robots_with_goal );
+
+    return 0;
+}
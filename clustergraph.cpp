@@ -0,0 +1,745 @@
+#include "clustergraph.h"
+#include "bitplane.h"
+#include "occupancypyramid.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+/* Costs of a step, scaled so that they stay integers. */
+static const uint32_t straight_cost = 10;
+static const uint32_t diagonal_cost = 14;
+
+static const uint32_t unreachable = 0xffffffff;
+static const uint32_t no_parent = 0xffffffff;
+
+/* The eight neighbours; the straight ones first, then every diagonal one between two of them. */
+static const int direction_x[ 8 ] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int direction_y[ 8 ] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+/* The octile distance, which is exact when nothing is in the way. */
+static uint32_t distance( const int x0, const int y0, const int x1, const int y1 )
+{
+    const uint32_t dx = std::abs( x1 - x0 );
+    const uint32_t dy = std::abs( y1 - y0 );
+
+    return straight_cost * std::max( dx, dy ) + (diagonal_cost - straight_cost) * std::min( dx, dy );
+}
+
+/*
+ * A search which never leaves a given rectangle of at most two clusters,
+ * which is small enough to simply go through every block of it in the
+ * order of their distance from the start. The steps only ever cost one
+ * of two small amounts, so the blocks waiting to be gone through are
+ * kept in a ring of buckets, one for every cost it could be waiting at.
+ */
+struct LocalSearch
+{
+    static const uint32_t no_target = 0xffffffff;
+    static const unsigned bucket_count = diagonal_cost + 1;
+
+    unsigned min_x;
+    unsigned min_y;
+
+    /* The rectangle is surrounded by a border of walls, so that the neighbours never have to be bounds checked. */
+    unsigned stride;
+    std::vector< uint8_t > is_free;
+
+    std::vector< uint32_t > g;
+    std::vector< uint16_t > parent;
+    std::vector< uint16_t > buckets[ bucket_count ];
+
+    uint32_t index_of( const unsigned x, const unsigned y ) const
+    {
+        return (y - min_y + 1) * stride + (x - min_x + 1);
+    }
+
+    unsigned x_of( const uint32_t index ) const
+    {
+        return min_x + index % stride - 1;
+    }
+
+    unsigned y_of( const uint32_t index ) const
+    {
+        return min_y + index / stride - 1;
+    }
+
+    /* Cost of the path from the start to a given block of the rectangle. */
+    uint32_t at( const unsigned x, const unsigned y ) const
+    {
+        return g[ index_of( x, y ) ];
+    }
+
+    /* Sets up the rectangle for any number of searches. */
+    void prepare( const BitPlane& walls, const unsigned rect_min_x, const unsigned rect_min_y, const unsigned rect_max_x, const unsigned rect_max_y )
+    {
+        min_x = rect_min_x;
+        min_y = rect_min_y;
+        stride = rect_max_x - rect_min_x + 3;
+
+        const unsigned height = rect_max_y - rect_min_y + 3;
+        assert( stride * height <= 0xffff );
+
+        is_free.assign( stride * height, 0 );
+        for( unsigned y = rect_min_y; y <= rect_max_y; ++y )
+        {
+            for( unsigned x = rect_min_x; x <= rect_max_x; ++x )
+                is_free[ index_of( x, y ) ] = !walls.get( x, y );
+        }
+
+        g.resize( stride * height );
+        parent.resize( stride * height );
+    }
+
+    void run( const unsigned start_x, const unsigned start_y, const uint32_t target )
+    {
+        std::fill( g.begin(), g.end(), unreachable );
+        for( auto& bucket: buckets )
+            bucket.clear();
+
+        const int offsets[ 8 ] = {
+            1, int( stride ), -1, -int( stride ),
+            int( stride ) + 1, int( stride ) - 1, -int( stride ) - 1, -int( stride ) + 1
+        };
+
+        const uint32_t start = index_of( start_x, start_y );
+        if( !is_free[ start ] )
+            return;
+
+        g[ start ] = 0;
+        parent[ start ] = start;
+        buckets[ 0 ].push_back( start );
+
+        std::size_t waiting = 1;
+        for( uint32_t cost = 0; waiting > 0; ++cost )
+        {
+            std::vector< uint16_t >& bucket = buckets[ cost % bucket_count ];
+            for( std::size_t i = 0; i < bucket.size(); ++i )
+            {
+                const uint32_t index = bucket[ i ];
+                waiting--;
+
+                /* Reached again more cheaply after it was put in here. */
+                if( g[ index ] != cost )
+                    continue;
+
+                if( index == target )
+                    return;
+
+                bool is_straight_free[ 4 ];
+                for( unsigned direction = 0; direction < 8; ++direction )
+                {
+                    const uint32_t next = index + offsets[ direction ];
+                    uint32_t next_cost;
+                    if( direction < 4 )
+                    {
+                        is_straight_free[ direction ] = is_free[ next ];
+                        if( !is_straight_free[ direction ] )
+                            continue;
+
+                        next_cost = cost + straight_cost;
+                    }
+                    else
+                    {
+                        /* A diagonal step is only allowed when both of the straight ones next to it are. */
+                        if( !is_straight_free[ direction - 4 ] || !is_straight_free[ (direction - 3) % 4 ] || !is_free[ next ] )
+                            continue;
+
+                        next_cost = cost + diagonal_cost;
+                    }
+
+                    if( next_cost >= g[ next ] )
+                        continue;
+
+                    g[ next ] = next_cost;
+                    parent[ next ] = index;
+                    buckets[ next_cost % bucket_count ].push_back( next );
+                    waiting++;
+                }
+            }
+
+            bucket.clear();
+        }
+    }
+};
+
+struct AbstractNode
+{
+    uint32_t generation;
+    uint32_t g;
+    uint32_t parent;
+    uint8_t is_closed;
+};
+
+/*
+ * Storage for a search through the entrances, kept between the searches
+ * and stamped with a generation so that nothing has to be cleared, like
+ * the one of AStarAlgorithm; every thread gets its own.
+ */
+struct AbstractArena
+{
+    std::vector< AbstractNode > nodes;
+
+    /* A binary heap of (f << 32) | node, with the smallest f first. */
+    std::vector< uint64_t > open;
+
+    uint32_t generation;
+
+    AbstractArena() : generation( 0 ) {}
+
+    AbstractNode& node( const uint32_t index )
+    {
+        return nodes[ index ];
+    }
+
+    /* Nobody keeps this one, so it doesn't matter which clusters it goes through. */
+    void touch( const unsigned )
+    {
+    }
+
+    void begin( const std::size_t node_count )
+    {
+        if( nodes.size() < node_count )
+            nodes.resize( node_count );
+
+        open.clear();
+        if( ++generation == 0 )
+        {
+            for( AbstractNode& node: nodes )
+                node.generation = 0;
+
+            generation = 1;
+        }
+    }
+};
+
+static thread_local LocalSearch local_search;
+static thread_local AbstractArena arena;
+
+ClusterGraph::ClusterGraph( const BitPlane& walls, const OccupancyPyramid& wall_pyramid ) :
+    m_walls( walls ),
+    m_wall_pyramid( wall_pyramid ),
+    m_clusters_x( (walls.width() + cluster_size - 1) / cluster_size ),
+    m_clusters_y( (walls.height() + cluster_size - 1) / cluster_size ),
+    m_clusters( m_clusters_x * m_clusters_y ),
+    m_version( 0 )
+{
+    for( unsigned cluster = 0; cluster < m_clusters.size(); ++cluster )
+        build_cluster( cluster );
+}
+
+unsigned ClusterGraph::version() const
+{
+    return m_version;
+}
+
+unsigned ClusterGraph::cluster_version( const unsigned cluster ) const
+{
+    return m_clusters[ cluster ].version;
+}
+
+unsigned ClusterGraph::cluster_of( const unsigned x, const unsigned y ) const
+{
+    return (y / cluster_size) * m_clusters_x + x / cluster_size;
+}
+
+void ClusterGraph::cluster_bounds( const unsigned cluster, unsigned& o_min_x, unsigned& o_min_y, unsigned& o_max_x, unsigned& o_max_y ) const
+{
+    o_min_x = (cluster % m_clusters_x) * cluster_size;
+    o_min_y = (cluster / m_clusters_x) * cluster_size;
+    o_max_x = std::min( o_min_x + cluster_size, m_walls.width() ) - 1;
+    o_max_y = std::min( o_min_y + cluster_size, m_walls.height() ) - 1;
+}
+
+/* Whenever there are no walls at all in a given rectangle, so that nothing has to be searched in it. */
+bool ClusterGraph::is_open( const unsigned min_x, const unsigned min_y, const unsigned max_x, const unsigned max_y ) const
+{
+    return m_wall_pyramid.is_area_empty( min_x, min_y, max_x - min_x + 1, max_y - min_y + 1 );
+}
+
+/*
+ * An entrance goes in the middle of every run of blocks along a side
+ * which are free on both sides of the border. The neighbouring cluster
+ * finds the same runs from its side, in the same order, which is what
+ * pairs the entrances up.
+ */
+void ClusterGraph::find_entrances( const unsigned cluster, const unsigned side, std::vector< uint32_t >& o_entrances ) const
+{
+    unsigned min_x, min_y, max_x, max_y;
+    cluster_bounds( cluster, min_x, min_y, max_x, max_y );
+
+    const int dx = direction_x[ side ];
+    const int dy = direction_y[ side ];
+
+    /* The blocks of the side, and which way is along it. */
+    const unsigned x = dx > 0 ? max_x : min_x;
+    const unsigned y = dy > 0 ? max_y : min_y;
+    const unsigned along_x = dx == 0;
+    const unsigned along_y = dy == 0;
+    const unsigned length = dx == 0 ? max_x - min_x + 1 : max_y - min_y + 1;
+
+    const int outside_x = int( x ) + dx;
+    const int outside_y = int( y ) + dy;
+    if( outside_x < 0 || outside_y < 0 || outside_x >= int( m_walls.width() ) || outside_y >= int( m_walls.height() ) )
+        return;
+
+    const unsigned width = m_walls.width();
+    unsigned run_begin = 0;
+    bool is_in_run = false;
+    for( unsigned i = 0; i <= length; ++i )
+    {
+        const bool is_open = i < length &&
+                             !m_walls.get( x + i * along_x, y + i * along_y ) &&
+                             !m_walls.get( outside_x + i * along_x, outside_y + i * along_y );
+
+        if( is_open && !is_in_run )
+            run_begin = i;
+        else if( !is_open && is_in_run )
+        {
+            const unsigned middle = (run_begin + i - 1) / 2;
+            o_entrances.push_back( (y + middle * along_y) * width + x + middle * along_x );
+        }
+
+        is_in_run = is_open;
+    }
+}
+
+void ClusterGraph::build_cluster( const unsigned cluster )
+{
+    Cluster& data = m_clusters[ cluster ];
+    data.version = m_version;
+    data.entrances.clear();
+    for( unsigned side = 0; side < 4; ++side )
+    {
+        data.side_begin[ side ] = data.entrances.size();
+        find_entrances( cluster, side, data.entrances );
+    }
+
+    data.side_begin[ 4 ] = data.entrances.size();
+    assert( data.entrances.size() <= max_entrances );
+
+    unsigned min_x, min_y, max_x, max_y;
+    cluster_bounds( cluster, min_x, min_y, max_x, max_y );
+
+    const unsigned count = data.entrances.size();
+    const unsigned width = m_walls.width();
+    data.distances.assign( count * count, unreachable );
+    if( is_open( min_x, min_y, max_x, max_y ) )
+    {
+        for( unsigned i = 0; i < count; ++i )
+        {
+            for( unsigned j = 0; j < count; ++j )
+                data.distances[ i * count + j ] = distance( data.entrances[ i ] % width, data.entrances[ i ] / width, data.entrances[ j ] % width, data.entrances[ j ] / width );
+        }
+
+        return;
+    }
+
+    local_search.prepare( m_walls, min_x, min_y, max_x, max_y );
+    for( unsigned i = 0; i < count; ++i )
+    {
+        local_search.run( data.entrances[ i ] % width, data.entrances[ i ] / width, LocalSearch::no_target );
+        for( unsigned j = 0; j < count; ++j )
+            data.distances[ i * count + j ] = local_search.at( data.entrances[ j ] % width, data.entrances[ j ] / width );
+    }
+}
+
+/*
+ * Works out the costs from a given block to every entrance of its cluster.
+ * @return Whenever it took a search, which is then left in local_search.
+ */
+bool ClusterGraph::find_entrance_distances( const unsigned cluster, const unsigned x, const unsigned y, uint32_t * o_distances ) const
+{
+    const Cluster& data = m_clusters[ cluster ];
+    const unsigned width = m_walls.width();
+
+    unsigned min_x, min_y, max_x, max_y;
+    cluster_bounds( cluster, min_x, min_y, max_x, max_y );
+    if( is_open( min_x, min_y, max_x, max_y ) )
+    {
+        for( unsigned i = 0; i < data.entrances.size(); ++i )
+            o_distances[ i ] = distance( x, y, data.entrances[ i ] % width, data.entrances[ i ] / width );
+
+        return false;
+    }
+
+    local_search.prepare( m_walls, min_x, min_y, max_x, max_y );
+    local_search.run( x, y, LocalSearch::no_target );
+    for( unsigned i = 0; i < data.entrances.size(); ++i )
+        o_distances[ i ] = local_search.at( data.entrances[ i ] % width, data.entrances[ i ] / width );
+
+    return true;
+}
+
+/* The node of the entrance on the other side of the border from a given one. */
+uint32_t ClusterGraph::partner( const unsigned cluster, const unsigned entrance ) const
+{
+    const Cluster& data = m_clusters[ cluster ];
+
+    unsigned side = 0;
+    while( entrance >= data.side_begin[ side + 1 ] )
+        side++;
+
+    const unsigned neighbour = int( cluster ) + direction_x[ side ] + direction_y[ side ] * int( m_clusters_x );
+    const unsigned opposite = (side + 2) % 4;
+
+    return neighbour * max_entrances + m_clusters[ neighbour ].side_begin[ opposite ] + entrance - data.side_begin[ side ];
+}
+
+void ClusterGraph::update( const unsigned x, const unsigned y )
+{
+    m_version++;
+
+    const unsigned cluster = cluster_of( x, y );
+    build_cluster( cluster );
+
+    /* A block on the border also changes the entrances of the cluster on the other side of it. */
+    unsigned min_x, min_y, max_x, max_y;
+    cluster_bounds( cluster, min_x, min_y, max_x, max_y );
+
+    if( x == max_x && x + 1 < m_walls.width() )
+        build_cluster( cluster + 1 );
+    if( y == max_y && y + 1 < m_walls.height() )
+        build_cluster( cluster + m_clusters_x );
+    if( x == min_x && x > 0 )
+        build_cluster( cluster - 1 );
+    if( y == min_y && y > 0 )
+        build_cluster( cluster - m_clusters_x );
+}
+
+/* Where a search goes from and to, and how those connect to the entrances of their clusters. */
+struct ClusterGraph::PathEnds
+{
+    unsigned start_x;
+    unsigned start_y;
+    unsigned goal_x;
+    unsigned goal_y;
+    unsigned start_cluster;
+    unsigned goal_cluster;
+
+    uint32_t start_distances[ max_entrances ];
+    uint32_t goal_distances[ max_entrances ];
+
+    /* Cost of the path between the two without leaving their cluster, when it's the same one. */
+    uint32_t direct;
+};
+
+/*
+ * Stores only the entrances it has reached, like the suspended search of
+ * AStarAlgorithm, along with the clusters whose entrances it has gone
+ * through, which are all that it depends on.
+ */
+struct ClusterGraph::PathSearch::State
+{
+    std::unordered_map< uint32_t, AbstractNode > nodes;
+    std::vector< uint64_t > open;
+    uint32_t generation;
+
+    PathEnds ends;
+    unsigned version;
+    std::vector< uint32_t > clusters;
+
+    State() : generation( 1 ) {}
+
+    /* Entrances which haven't been reached yet come out with the generation of zero, like in the arena. */
+    AbstractNode& node( const uint32_t index )
+    {
+        return nodes[ index ];
+    }
+
+    void touch( const unsigned cluster )
+    {
+        if( clusters.empty() || clusters.back() != cluster )
+            clusters.push_back( cluster );
+    }
+
+    void begin( const std::size_t )
+    {
+        nodes.clear();
+        open.clear();
+    }
+};
+
+ClusterGraph::PathSearch::PathSearch()
+{
+}
+
+ClusterGraph::PathSearch::~PathSearch()
+{
+}
+
+void ClusterGraph::PathSearch::clear()
+{
+    m_state.reset();
+}
+
+/* Neither the start nor the goal are entrances, so how they connect to the ones of their clusters is worked out first. */
+void ClusterGraph::find_path_ends( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, PathEnds& o_ends ) const
+{
+    o_ends.start_x = start_x;
+    o_ends.start_y = start_y;
+    o_ends.goal_x = goal_x;
+    o_ends.goal_y = goal_y;
+    o_ends.start_cluster = cluster_of( start_x, start_y );
+    o_ends.goal_cluster = cluster_of( goal_x, goal_y );
+
+    const bool has_searched = find_entrance_distances( o_ends.goal_cluster, goal_x, goal_y, o_ends.goal_distances );
+
+    o_ends.direct = unreachable;
+    if( o_ends.start_cluster == o_ends.goal_cluster )
+        o_ends.direct = has_searched ? local_search.at( start_x, start_y ) : distance( start_x, start_y, goal_x, goal_y );
+
+    find_entrance_distances( o_ends.start_cluster, start_x, start_y, o_ends.start_distances );
+}
+
+bool ClusterGraph::is_search_intact( const PathSearch::State& search ) const
+{
+    if( search.version == m_version )
+        return true;
+
+    for( const uint32_t cluster: search.clusters )
+    {
+        if( m_clusters[ cluster ].version > search.version )
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Starts a search in @a storage when @a is_new, and otherwise carries on
+ * with the one in there, until it either reaches the goal, runs out of
+ * places to go, or runs out of @a io_budget.
+ */
+template< typename Storage >
+ClusterGraph::PathResult ClusterGraph::search_path( Storage& storage, const PathEnds& ends, const bool is_new, std::size_t& io_budget, std::vector< uint32_t >& o_waypoints ) const
+{
+    const unsigned width = m_walls.width();
+    const Cluster& start_data = m_clusters[ ends.start_cluster ];
+
+    /* Every cluster has room for the most entrances it could have, followed by the goal and the start. */
+    const uint32_t goal_node = m_clusters.size() * max_entrances;
+    const uint32_t start_node = goal_node + 1;
+
+    auto position = [&]( const uint32_t node ) {
+        if( node == goal_node )
+            return uint32_t( ends.goal_y * width + ends.goal_x );
+        if( node == start_node )
+            return uint32_t( ends.start_y * width + ends.start_x );
+
+        return m_clusters[ node / max_entrances ].entrances[ node % max_entrances ];
+    };
+
+    auto reach = [&]( const uint32_t node, const uint32_t g, const uint32_t parent ) {
+        AbstractNode& data = storage.node( node );
+        if( data.generation == storage.generation && (data.is_closed || data.g <= g) )
+            return;
+
+        data.generation = storage.generation;
+        data.g = g;
+        data.parent = parent;
+        data.is_closed = 0;
+
+        const uint32_t here = position( node );
+        const uint64_t f = g + distance( here % width, here / width, ends.goal_x, ends.goal_y ) * 5 / 4;
+        storage.open.push_back( (f << 32) | node );
+        std::push_heap( storage.open.begin(), storage.open.end(), std::greater< uint64_t >() );
+    };
+
+    if( is_new )
+    {
+        storage.begin( goal_node + 2 );
+        storage.touch( ends.start_cluster );
+        storage.touch( ends.goal_cluster );
+        reach( start_node, 0, no_parent );
+    }
+
+    while( !storage.open.empty() )
+    {
+        const uint32_t node = storage.open.front() & 0xffffffff;
+        AbstractNode& data = storage.node( node );
+        if( !data.is_closed )
+        {
+            if( io_budget == 0 )
+                return PathResult::OutOfBudget;
+
+            io_budget--;
+        }
+
+        std::pop_heap( storage.open.begin(), storage.open.end(), std::greater< uint64_t >() );
+        storage.open.pop_back();
+
+        if( data.is_closed )
+            continue;
+
+        data.is_closed = 1;
+        if( node == goal_node )
+            break;
+
+        const uint32_t g = data.g;
+        if( node == start_node )
+        {
+            for( unsigned i = 0; i < start_data.entrances.size(); ++i )
+            {
+                if( ends.start_distances[ i ] != unreachable )
+                    reach( ends.start_cluster * max_entrances + i, g + ends.start_distances[ i ], node );
+            }
+
+            if( ends.direct != unreachable )
+                reach( goal_node, g + ends.direct, node );
+
+            continue;
+        }
+
+        const unsigned cluster = node / max_entrances;
+        const unsigned entrance = node % max_entrances;
+        const Cluster& cluster_data = m_clusters[ cluster ];
+        const unsigned count = cluster_data.entrances.size();
+
+        /* The entrances on the other side only change along with the ones on this side. */
+        storage.touch( cluster );
+
+        reach( partner( cluster, entrance ), g + straight_cost, node );
+        for( unsigned i = 0; i < count; ++i )
+        {
+            const uint32_t cost = cluster_data.distances[ entrance * count + i ];
+            if( i != entrance && cost != unreachable )
+                reach( cluster * max_entrances + i, g + cost, node );
+        }
+
+        if( cluster == ends.goal_cluster && ends.goal_distances[ entrance ] != unreachable )
+            reach( goal_node, g + ends.goal_distances[ entrance ], node );
+    }
+
+    const AbstractNode& goal = storage.node( goal_node );
+    if( goal.generation != storage.generation || !goal.is_closed )
+        return PathResult::NotFound;
+
+    for( uint32_t node = goal_node; node != start_node; node = storage.node( node ).parent )
+        o_waypoints.push_back( position( node ) );
+
+    return PathResult::Found;
+}
+
+bool ClusterGraph::find_path( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, std::vector< uint32_t >& o_waypoints ) const
+{
+    std::size_t budget = std::size_t( -1 );
+    PathSearch search;
+
+    return find_path( start_x, start_y, goal_x, goal_y, budget, search, o_waypoints ) == PathResult::Found;
+}
+
+/*
+ * A search which doesn't fit into the budget is started over in storage
+ * of its own, the same way as in AStarAlgorithm, so that the ones which
+ * do fit keep using the much faster arena.
+ */
+ClusterGraph::PathResult ClusterGraph::find_path( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, std::size_t& io_budget, PathSearch& io_search, std::vector< uint32_t >& o_waypoints ) const
+{
+    o_waypoints.clear();
+    if( m_walls.get( start_x, start_y ) || m_walls.get( goal_x, goal_y ) )
+    {
+        io_search.clear();
+        return PathResult::NotFound;
+    }
+
+    if( start_x == goal_x && start_y == goal_y )
+    {
+        io_search.clear();
+        return PathResult::Found;
+    }
+
+    PathSearch::State * suspended = io_search.m_state.get();
+    if( suspended && (suspended->ends.start_x != start_x || suspended->ends.start_y != start_y ||
+                      suspended->ends.goal_x != goal_x || suspended->ends.goal_y != goal_y || !is_search_intact( *suspended )) )
+    {
+        io_search.clear();
+        suspended = nullptr;
+    }
+
+    PathResult result;
+    if( suspended )
+        result = search_path( *suspended, suspended->ends, false, io_budget, o_waypoints );
+    else
+    {
+        PathEnds ends;
+        find_path_ends( start_x, start_y, goal_x, goal_y, ends );
+        result = search_path( arena, ends, true, io_budget, o_waypoints );
+        if( result == PathResult::OutOfBudget )
+        {
+            io_search.m_state.reset( new PathSearch::State() );
+            suspended = io_search.m_state.get();
+            suspended->ends = ends;
+            suspended->version = m_version;
+
+            std::size_t no_budget = 0;
+            search_path( *suspended, ends, true, no_budget, o_waypoints );
+        }
+    }
+
+    if( result != PathResult::OutOfBudget )
+    {
+        io_search.clear();
+        return result;
+    }
+
+    std::sort( suspended->clusters.begin(), suspended->clusters.end() );
+    suspended->clusters.erase( std::unique( suspended->clusters.begin(), suspended->clusters.end() ), suspended->clusters.end() );
+
+    return result;
+}
+
+bool ClusterGraph::find_local_path( const unsigned start_x, const unsigned start_y, const unsigned target_x, const unsigned target_y, std::vector< uint32_t >& o_path ) const
+{
+    o_path.clear();
+    if( start_x == target_x && start_y == target_y )
+        return true;
+
+    const unsigned start_cluster = cluster_of( start_x, start_y );
+    const unsigned target_cluster = cluster_of( target_x, target_y );
+    const int cluster_dx = int( target_cluster % m_clusters_x ) - int( start_cluster % m_clusters_x );
+    const int cluster_dy = int( target_cluster / m_clusters_x ) - int( start_cluster / m_clusters_x );
+    if( std::abs( cluster_dx ) + std::abs( cluster_dy ) > 1 )
+        return false;
+
+    unsigned min_x, min_y, max_x, max_y;
+    unsigned target_min_x, target_min_y, target_max_x, target_max_y;
+    cluster_bounds( start_cluster, min_x, min_y, max_x, max_y );
+    cluster_bounds( target_cluster, target_min_x, target_min_y, target_max_x, target_max_y );
+    min_x = std::min( min_x, target_min_x );
+    min_y = std::min( min_y, target_min_y );
+    max_x = std::max( max_x, target_max_x );
+    max_y = std::max( max_y, target_max_y );
+
+    const unsigned width = m_walls.width();
+
+    /* Without any walls in the way, diagonally until in line with the target and then straight is as short as it gets. */
+    if( is_open( min_x, min_y, max_x, max_y ) )
+    {
+        unsigned x = target_x;
+        unsigned y = target_y;
+        while( x != start_x || y != start_y )
+        {
+            o_path.push_back( y * width + x );
+            x += (start_x > x) - (start_x < x);
+            y += (start_y > y) - (start_y < y);
+        }
+
+        return true;
+    }
+
+    local_search.prepare( m_walls, min_x, min_y, max_x, max_y );
+
+    const uint32_t target = local_search.index_of( target_x, target_y );
+    local_search.run( start_x, start_y, target );
+    if( local_search.g[ target ] == unreachable )
+        return false;
+
+    const uint32_t start = local_search.index_of( start_x, start_y );
+    for( uint32_t index = target; index != start; index = local_search.parent[ index ] )
+        o_path.push_back( local_search.y_of( index ) * width + local_search.x_of( index ) );
+
+    return true;
+}
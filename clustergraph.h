@@ -0,0 +1,174 @@
+#ifndef CLUSTERGRAPH_H
+#define CLUSTERGRAPH_H
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+class BitPlane;
+class OccupancyPyramid;
+
+/**
+ * @brief A coarse graph of a map for finding long paths quickly, in the
+ *        manner of HPA*. The map is split into square clusters; every run
+ *        of free blocks along the border of two clusters gets an entrance
+ *        on both sides of it, and the cost of the shortest path between
+ *        every two entrances of the same cluster is worked out up front.
+ *
+ * A search then only has to go from entrance to entrance, which on a big
+ * map is orders of magnitude less than going from block to block, and
+ * the path it finds is filled in one cluster at a time, as it's walked.
+ * The paths are close to, but not always exactly, the shortest ones.
+ *
+ * Moves are made between the eight neighbouring blocks, without cutting
+ * the corners of walls, like everywhere else; walls are the only thing
+ * which is considered to be in the way. Clusters without any, which the
+ * pyramid of the walls tells at a glance, aren't searched at all, since
+ * the octile distance is then exact.
+ *
+ * Searching doesn't modify the graph, so any number of threads can
+ * search at the same time, as long as it isn't being updated.
+ */
+class ClusterGraph
+{
+    public:
+        /* Width and height of a cluster, in blocks. */
+        static const unsigned cluster_size = 16;
+
+        /* One per run of free blocks along each of the four sides, and the runs are at least a wall apart. */
+        static const unsigned max_entrances = 4 * cluster_size / 2;
+
+        /* What a search with a budget came to. */
+        enum class PathResult
+        {
+            Found,
+            NotFound,
+            OutOfBudget
+        };
+
+        /**
+         * @brief A search through the entrances which ran out of its budget,
+         *        kept by whoever started it until find_path() carries on
+         *        with it; only the entrances it has reached are stored.
+         */
+        class PathSearch
+        {
+            friend class ClusterGraph;
+
+            struct State;
+            std::unique_ptr< State > m_state;
+
+            public:
+                explicit PathSearch();
+                ~PathSearch();
+
+                PathSearch( const PathSearch& ) = delete;
+                PathSearch& operator =( const PathSearch& ) = delete;
+
+                /**
+                 * @brief Drops the search, if there's one.
+                 */
+                void clear();
+        };
+
+    private:
+        struct Cluster
+        {
+            /* The entrances, as y * width + x; those on the right side first, then the bottom, left and top ones. */
+            std::vector< uint32_t > entrances;
+            uint8_t side_begin[ 5 ];
+
+            /* Cost of the shortest path inside of the cluster between every two entrances. */
+            std::vector< uint32_t > distances;
+
+            /* The version of the graph in which the cluster was last built. */
+            unsigned version;
+        };
+
+        const BitPlane& m_walls;
+        const OccupancyPyramid& m_wall_pyramid;
+        unsigned m_clusters_x;
+        unsigned m_clusters_y;
+        std::vector< Cluster > m_clusters;
+        unsigned m_version;
+
+        void cluster_bounds( const unsigned cluster, unsigned& o_min_x, unsigned& o_min_y, unsigned& o_max_x, unsigned& o_max_y ) const;
+        bool is_open( const unsigned min_x, const unsigned min_y, const unsigned max_x, const unsigned max_y ) const;
+        bool find_entrance_distances( const unsigned cluster, const unsigned x, const unsigned y, uint32_t * o_distances ) const;
+        void find_entrances( const unsigned cluster, const unsigned side, std::vector< uint32_t >& o_entrances ) const;
+        void build_cluster( const unsigned cluster );
+        uint32_t partner( const unsigned cluster, const unsigned entrance ) const;
+
+        struct PathEnds;
+        void find_path_ends( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, PathEnds& o_ends ) const;
+        bool is_search_intact( const PathSearch::State& search ) const;
+
+        template< typename Storage >
+        PathResult search_path( Storage& storage, const PathEnds& ends, const bool is_new, std::size_t& io_budget, std::vector< uint32_t >& o_waypoints ) const;
+
+    public:
+        /**
+         * @brief Builds the graph of the walls of a given plane, which
+         *        has to stay around for as long as the graph does, and
+         *        be kept up to date, like the pyramid of it, before
+         *        the graph is.
+         */
+        explicit ClusterGraph( const BitPlane& walls, const OccupancyPyramid& wall_pyramid );
+
+        ClusterGraph( const ClusterGraph& ) = delete;
+        ClusterGraph& operator =( const ClusterGraph& ) = delete;
+
+        /**
+         * @return Number which grows every time the graph is updated.
+         */
+        unsigned version() const;
+
+        /**
+         * @return The version() in which a given cluster was last rebuilt;
+         *         a path planned before then may not hold through it.
+         */
+        unsigned cluster_version( const unsigned cluster ) const;
+
+        /**
+         * @return Index of the cluster a given block is in.
+         */
+        unsigned cluster_of( const unsigned x, const unsigned y ) const;
+
+        /**
+         * @brief Rebuilds the clusters affected by a change of a given
+         *        block of the plane; to be called after every change.
+         */
+        void update( const unsigned x, const unsigned y );
+
+        /**
+         * @brief Finds a path between two blocks through the entrances.
+         * @param o_waypoints Receives the entrances to go through, as
+         *        y * width + x, the goal first and the next one last;
+         *        every two consecutive ones are either in the same
+         *        cluster or right next to each other.
+         * @return Whenever a path was found.
+         */
+        bool find_path( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, std::vector< uint32_t >& o_waypoints ) const;
+
+        /**
+         * @brief Like the other find_path(), but stops once @a io_budget
+         *        runs out, taking every entrance gone through out of it.
+         * @param io_search Carried on with when it's a search between the
+         *        same two blocks and no cluster it has gone through has
+         *        been rebuilt since; otherwise a new one is started, and
+         *        left in there if it runs out as well.
+         */
+        PathResult find_path( const unsigned start_x, const unsigned start_y, const unsigned goal_x, const unsigned goal_y, std::size_t& io_budget, PathSearch& io_search, std::vector< uint32_t >& o_waypoints ) const;
+
+        /**
+         * @brief Finds the shortest path between two blocks without leaving
+         *        the clusters they're in, which have to be either the same
+         *        or next to each other, like two consecutive waypoints.
+         * @param o_path Receives every block on the way, as y * width + x,
+         *        the target first and the one right after the start last.
+         * @return Whenever a path was found.
+         */
+        bool find_local_path( const unsigned start_x, const unsigned start_y, const unsigned target_x, const unsigned target_y, std::vector< uint32_t >& o_path ) const;
+};
+
+#endif // CLUSTERGRAPH_H
@@ -0,0 +1,381 @@
+#include "cooperativealgorithm.h"
+#include "routingalgorithmregistry.h"
+#include "reservationtable.h"
+#include "robot.h"
+#include "scene.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+
+static const StaticAlgorithmRegistration registrar( "Cooperative A*", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new CooperativeAlgorithm() );
+} );
+
+/* Number of slots planned ahead; a new plan is made once half of them have passed. */
+static const uint32_t window = 16;
+
+/* Most states a single plan may look at before settling for the best one so far. */
+static const std::size_t max_expansions = 4096;
+
+/* Fewest it looks at however small the planning budget is, so that it can always get a step closer. */
+static const std::size_t min_expansions = 4;
+
+static const uint32_t no_parent = 0xffffffff;
+
+static const int direction_x[ 4 ] = { 1, 0, -1, 0 };
+static const int direction_y[ 4 ] = { 0, 1, 0, -1 };
+
+struct TimedNode
+{
+    uint32_t block;
+    uint32_t depth;
+    uint32_t parent;
+};
+
+/*
+ * A set of states in a single open addressing table, which unlike a
+ * std::unordered_set doesn't allocate for every one put in. Its slots
+ * only count when stamped with the current generation, so emptying it
+ * doesn't have to touch them either.
+ */
+struct ReachedSet
+{
+    std::vector< uint64_t > keys;
+    std::vector< uint32_t > stamps;
+    uint32_t generation;
+    std::size_t count;
+
+    ReachedSet() : generation( 0 ), count( 0 ) {}
+
+    static std::size_t slot_of( const uint64_t key, const std::size_t mask )
+    {
+        return std::size_t( (key * 0x9e3779b97f4a7c15ull) >> 32 ) & mask;
+    }
+
+    void clear()
+    {
+        count = 0;
+        if( ++generation == 0 )
+        {
+            std::fill( stamps.begin(), stamps.end(), 0 );
+            generation = 1;
+        }
+    }
+
+    /* Doubles the table, keeping it at most half full. */
+    void grow()
+    {
+        std::vector< uint64_t > old_keys;
+        std::vector< uint32_t > old_stamps;
+        old_keys.swap( keys );
+        old_stamps.swap( stamps );
+
+        keys.resize( std::max< std::size_t >( old_keys.size() * 2, 1024 ) );
+        stamps.resize( keys.size(), 0 );
+
+        const std::size_t mask = keys.size() - 1;
+        for( std::size_t i = 0; i < old_keys.size(); ++i )
+        {
+            if( old_stamps[ i ] != generation )
+                continue;
+
+            std::size_t slot = slot_of( old_keys[ i ], mask );
+            while( stamps[ slot ] == generation )
+                slot = (slot + 1) & mask;
+
+            keys[ slot ] = old_keys[ i ];
+            stamps[ slot ] = generation;
+        }
+    }
+
+    /* @return Whenever the state wasn't in the set yet. */
+    bool insert( const uint64_t key )
+    {
+        if( (count + 1) * 2 > keys.size() )
+            grow();
+
+        const std::size_t mask = keys.size() - 1;
+        for( std::size_t slot = slot_of( key, mask ); ; slot = (slot + 1) & mask )
+        {
+            if( stamps[ slot ] != generation )
+            {
+                keys[ slot ] = key;
+                stamps[ slot ] = generation;
+                count++;
+                return true;
+            }
+
+            if( keys[ slot ] == key )
+                return false;
+        }
+    }
+};
+
+/*
+ * Storage for a plan, kept between the plans so that planning doesn't
+ * allocate once it has warmed up. Every step takes one slot, whenever
+ * it's a move or a wait, so the first time a block is reached at some
+ * depth is already the cheapest.
+ */
+struct TimedArena
+{
+    std::vector< TimedNode > nodes;
+
+    /* Every state reached so far, as (depth << 32) | block. */
+    ReachedSet reached;
+
+    /* A binary heap of (f << 48) | ((window - depth) << 32) | node, with the smallest f, and then the deepest, first. */
+    std::vector< uint64_t > open;
+};
+
+static thread_local TimedArena arena;
+
+CooperativeAlgorithm::CooperativeAlgorithm() :
+    m_start_slot( 0 ),
+    m_checked_slot( 0 ),
+    m_path_goal_x( 0 ),
+    m_path_goal_y( 0 ),
+    m_table( nullptr ),
+    m_owner( 0 )
+{
+}
+
+CooperativeAlgorithm::~CooperativeAlgorithm()
+{
+    release();
+}
+
+void CooperativeAlgorithm::initialize( const Robot& robot )
+{
+    release();
+    m_path.clear();
+}
+
+bool CooperativeAlgorithm::is_parallel_safe() const
+{
+    return false;
+}
+
+void CooperativeAlgorithm::release()
+{
+    for( const auto& reservation: m_reserved )
+        m_table->release( reservation.first, reservation.second, m_owner );
+
+    m_reserved.clear();
+}
+
+void CooperativeAlgorithm::plan( const Robot& robot, const bool is_forced )
+{
+    release();
+
+    const Scene& scene = robot.scene();
+    const TiledArray2d< ObstacleType >& map = robot.obstacle_map();
+    const int width = scene.width();
+    const int height = scene.height();
+    const int goal_x = robot.goal_x();
+    const int goal_y = robot.goal_y();
+
+    m_table = &scene.reservation_table();
+    m_owner = robot.id();
+    m_start_slot = m_table->now();
+    m_path_goal_x = goal_x;
+    m_path_goal_y = goal_y;
+
+    auto is_passable = [&]( const int x, const int y ) {
+        if( x < 0 || y < 0 || x >= width || y >= height || map.at( x, y ) == ObstacleType::Wall )
+            return false;
+
+        const Robot * other = scene.get_robot( x, y );
+        return !other || other == &robot || other->has_goal();
+    };
+
+    /* Whatever the plans say, a block another robot is still in can't be had in the current slot. */
+    auto is_free_at = [&]( const uint32_t block, const uint32_t depth ) {
+        if( depth == 0 )
+        {
+            const Robot * other = scene.get_robot( block % width, block / width );
+            if( other && other != &robot )
+                return false;
+        }
+
+        if( is_forced )
+            return true;
+
+        const uint32_t owner = m_table->owner( block, m_start_slot + depth );
+        return owner == ReservationTable::no_owner || owner == m_owner;
+    };
+
+    auto estimate = [&]( const uint32_t block ) {
+        return uint32_t( std::abs( int( block % width ) - goal_x ) + std::abs( int( block / width ) - goal_y ) );
+    };
+
+    auto reach = [&]( const uint32_t block, const uint32_t depth, const uint32_t parent ) {
+        if( !arena.reached.insert( (uint64_t( depth ) << 32) | block ) )
+            return;
+
+        const TimedNode node = { block, depth, parent };
+        arena.nodes.push_back( node );
+
+        const uint64_t f = depth + estimate( block );
+        arena.open.push_back( (f << 48) | (uint64_t( window - depth ) << 32) | (arena.nodes.size() - 1) );
+        std::push_heap( arena.open.begin(), arena.open.end(), std::greater< uint64_t >() );
+    };
+
+    arena.nodes.clear();
+    arena.reached.clear();
+    arena.open.clear();
+
+    reach( robot.y() * width + robot.x(), 0, no_parent );
+
+    /* Without a way to the goal, or to the end of the window, the plan goes as close to the goal as it can. */
+    uint32_t best = 0;
+    const std::size_t expansion_limit = std::min( max_expansions, std::max( planning_budget(), min_expansions ) );
+    std::size_t expansions = 0;
+    for( ; !arena.open.empty() && expansions < expansion_limit; ++expansions )
+    {
+        std::pop_heap( arena.open.begin(), arena.open.end(), std::greater< uint64_t >() );
+        const uint32_t index = arena.open.back() & 0xffffffff;
+        arena.open.pop_back();
+
+        const TimedNode node = arena.nodes[ index ];
+        const TimedNode& best_node = arena.nodes[ best ];
+        if( estimate( node.block ) < estimate( best_node.block ) || (estimate( node.block ) == estimate( best_node.block ) && node.depth > best_node.depth) )
+            best = index;
+
+        if( estimate( node.block ) == 0 || node.depth == window )
+        {
+            best = index;
+            break;
+        }
+
+        /* Moving into a block takes the slot it's left in and the one it's entered in. */
+        if( is_free_at( node.block, node.depth + 1 ) )
+            reach( node.block, node.depth + 1, index );
+
+        const int x = node.block % width;
+        const int y = node.block / width;
+        for( unsigned direction = 0; direction < 4; ++direction )
+        {
+            const int next_x = x + direction_x[ direction ];
+            const int next_y = y + direction_y[ direction ];
+            if( !is_passable( next_x, next_y ) )
+                continue;
+
+            const uint32_t next = next_y * width + next_x;
+            if( is_free_at( next, node.depth ) && is_free_at( next, node.depth + 1 ) )
+                reach( next, node.depth + 1, index );
+        }
+    }
+
+    /* A shorter plan is all it settles for, so it's never left with anything to carry on with. */
+    spend_planning_budget( planning_spent() + expansions, false );
+
+    m_path.clear();
+    for( uint32_t index = best; index != no_parent; index = arena.nodes[ index ].parent )
+        m_path.push_back( arena.nodes[ index ].block );
+
+    std::reverse( m_path.begin(), m_path.end() );
+
+    /*
+     * Waiting at the end of the plan is only held for one slot; otherwise a
+     * robot with nowhere better to be would keep its block for the whole
+     * window, and the robots which need to get past it would never plan to.
+     */
+    while( m_path.size() > 2 && m_path[ m_path.size() - 1 ] == m_path[ m_path.size() - 2 ] && m_path[ m_path.size() - 2 ] == m_path[ m_path.size() - 3 ] )
+        m_path.pop_back();
+
+    auto reserve = [&]( const uint32_t block, const uint32_t slot ) {
+        if( is_forced ? m_table->take( block, slot, m_owner ) : m_table->reserve( block, slot, m_owner ) )
+            m_reserved.push_back( std::make_pair( block, slot ) );
+    };
+
+    for( uint32_t step = 0; step < m_path.size(); ++step )
+    {
+        reserve( m_path[ step ], m_start_slot + step );
+        if( step + 1 < m_path.size() )
+            reserve( m_path[ step + 1 ], m_start_slot + step );
+    }
+
+    m_checked_slot = m_start_slot;
+
+    /*
+     * Not even able to stay where it is, because others planned to come
+     * through; since it's there either way, it plans again as if nobody
+     * else had planned anything, and takes over whatever it needs. The
+     * robots it takes the blocks from notice, and plan around it instead.
+     */
+    if( m_path.size() == 1 && !is_forced )
+        plan( robot, true );
+}
+
+bool CooperativeAlgorithm::is_plan_intact() const
+{
+    for( const auto& reservation: m_reserved )
+    {
+        if( reservation.second >= m_table->now() && m_table->owner( reservation.first, reservation.second ) != m_owner )
+            return false;
+    }
+
+    return true;
+}
+
+float CooperativeAlgorithm::run( const Robot& robot, const float elapsed )
+{
+    const unsigned width = robot.scene().width();
+    const uint32_t here = robot.y() * width + robot.x();
+    const uint32_t now = robot.scene().reservation_table().now();
+
+    bool needs_plan = m_path.empty() || m_path_goal_x != robot.goal_x() || m_path_goal_y != robot.goal_y() || now < m_start_slot;
+
+    /* Where the robot is in the plan: on time, already in the next block, or still in the previous one. */
+    uint32_t target = here;
+    if( !needs_plan )
+    {
+        const uint32_t step = now - m_start_slot;
+        if( step >= window / 2 || step + 1 >= m_path.size() )
+            needs_plan = true;
+        else if( m_path[ step ] == here )
+            target = m_path[ step + 1 ];
+        else if( m_path[ step + 1 ] == here )
+            target = here;
+        else if( step > 0 && m_path[ step - 1 ] == here )
+            target = m_path[ step ];
+        else
+            needs_plan = true;
+
+        /* The plans went wrong somewhere if another robot is still where this one is headed. */
+        const Robot * other = robot.scene().get_robot( target % width, target / width );
+        if( robot.obstacle_map().at( target % width, target / width ) == ObstacleType::Wall || (other && other != &robot) )
+            needs_plan = true;
+
+        /* Somebody might have taken over some of the plan; that can only happen when others plan, so it's only checked once a slot. */
+        if( !needs_plan && m_checked_slot != now )
+        {
+            needs_plan = !is_plan_intact();
+            m_checked_slot = now;
+        }
+    }
+
+    if( needs_plan )
+    {
+        plan( robot );
+        target = m_path.size() > 1 ? m_path[ 1 ] : here;
+    }
+
+    /* Worked out relative to the robot's block, since on big maps adding the fraction to the position loses what's left of the way to the middle. */
+    const float to_x = int( target % width ) - int( robot.x() ) + 0.5f - robot.frac_x();
+    const float to_y = int( target / width ) - int( robot.y() ) + 0.5f - robot.frac_y();
+
+    /*
+     * Waiting is done in the middle of the block, where the robot stops
+     * once it's within a tick's travel of it; robots cover a block a
+     * second. At the goal it keeps going, so that it arrives.
+     */
+    const bool is_goal = robot.x() == robot.goal_x() && robot.y() == robot.goal_y();
+    if( target == here && !is_goal && fabsf( to_x ) <= elapsed && fabsf( to_y ) <= elapsed )
+        return NAN;
+
+    return atan2f( to_y, to_x );
+}
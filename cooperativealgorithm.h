@@ -0,0 +1,58 @@
+#ifndef COOPERATIVEALGORITHM_H
+#define COOPERATIVEALGORITHM_H
+
+#include "routingalgorithm.h"
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+class ReservationTable;
+
+/**
+ * @brief Plans where to be in each of the next few moments, moving between
+ *        the four neighbouring blocks or waiting, around the blocks other
+ *        robots have reserved in the Scene's ReservationTable, and then
+ *        reserves its own plan; this is windowed cooperative A*.
+ *
+ * The robots plan one at a time, in their order, so the earlier ones get
+ * the first pick. Walls go by what the robot has seen, with blocks it has
+ * never seen assumed to be free, and robots without a goal, which don't
+ * move, are treated as walls. Robots using other algorithms don't reserve
+ * anything, so they're not avoided. A robot boxed in by others' plans
+ * takes over what it needs, and they plan again.
+ *
+ * A plan looks at no more states than the planning budget allows, and
+ * goes as far as it got with those; the plans are short enough to not
+ * be worth carrying on with in the following runs.
+ */
+class CooperativeAlgorithm : public RoutingAlgorithm
+{
+    /* Blocks to be in, as y * width + x, one per slot from m_start_slot on. */
+    std::vector< uint32_t > m_path;
+    uint32_t m_start_slot;
+
+    /* Last slot in which the reservations were checked to still be this robot's. */
+    uint32_t m_checked_slot;
+    unsigned m_path_goal_x;
+    unsigned m_path_goal_y;
+
+    /* What has been reserved, as block and slot, so that it can be released when planning again. */
+    ReservationTable * m_table;
+    uint32_t m_owner;
+    std::vector< std::pair< uint32_t, uint32_t > > m_reserved;
+
+    void release();
+    void plan( const Robot& robot, const bool is_forced = false );
+    bool is_plan_intact() const;
+
+    public:
+        explicit CooperativeAlgorithm();
+        virtual ~CooperativeAlgorithm();
+
+        virtual void initialize( const Robot& robot ) override;
+        virtual float run( const Robot& robot, const float elapsed ) override;
+        virtual bool is_parallel_safe() const override;
+};
+
+#endif // COOPERATIVEALGORITHM_H
@@ -0,0 +1,352 @@
+#include "dstarlitealgorithm.h"
+#include "routingalgorithmregistry.h"
+#include "robot.h"
+
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+static const StaticAlgorithmRegistration registrar( "D* Lite", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new DStarLiteAlgorithm() );
+} );
+
+/* Costs of a step, scaled so that they stay integers. */
+static const uint32_t straight_cost = 10;
+static const uint32_t diagonal_cost = 14;
+
+/* Small enough that adding a heuristic and the key modifier to it can't overflow. */
+static const uint32_t infinity = 0x3fffffff;
+
+static const uint64_t not_queued = ~uint64_t( 0 );
+
+/* The eight neighbours; the straight ones first, then every diagonal one between two of them. */
+static const int direction_x[ 8 ] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int direction_y[ 8 ] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+/* The octile distance, which is exact when nothing is in the way. */
+static uint32_t distance( const unsigned x0, const unsigned y0, const unsigned x1, const unsigned y1 )
+{
+    const uint32_t dx = x0 > x1 ? x0 - x1 : x1 - x0;
+    const uint32_t dy = y0 > y1 ? y0 - y1 : y1 - y0;
+
+    return straight_cost * std::max( dx, dy ) + (diagonal_cost - straight_cost) * std::min( dx, dy );
+}
+
+DStarLiteAlgorithm::Node::Node() :
+    g( infinity ),
+    rhs( infinity ),
+    queued_key( not_queued )
+{
+}
+
+bool DStarLiteAlgorithm::Node::operator ==( const Node& node ) const
+{
+    return g == node.g && rhs == node.rhs && queued_key == node.queued_key;
+}
+
+bool DStarLiteAlgorithm::QueueEntry::operator >( const QueueEntry& entry ) const
+{
+    return key > entry.key || (key == entry.key && index > entry.index);
+}
+
+DStarLiteAlgorithm::DStarLiteAlgorithm() :
+    m_nodes( 0, 0 ),
+    m_is_initialized( false ),
+    m_goal_x( 0 ),
+    m_goal_y( 0 ),
+    m_last_x( 0 ),
+    m_last_y( 0 ),
+    m_key_modifier( 0 )
+{
+}
+
+DStarLiteAlgorithm::~DStarLiteAlgorithm()
+{
+}
+
+void DStarLiteAlgorithm::initialize( const Robot& robot )
+{
+    m_is_initialized = false;
+}
+
+void DStarLiteAlgorithm::reset( const Robot& robot )
+{
+    const TiledArray2d< ObstacleType >& map = robot.obstacle_map();
+
+    m_nodes = TiledArray2d< Node >( map.width(), map.height() );
+    m_queue.clear();
+    m_goal_x = robot.goal_x();
+    m_goal_y = robot.goal_y();
+    m_last_x = robot.x();
+    m_last_y = robot.y();
+    m_key_modifier = 0;
+    m_is_initialized = true;
+
+    Node goal;
+    goal.rhs = 0;
+    goal.queued_key = key( goal, m_goal_x, m_goal_y, robot.x(), robot.y() );
+    m_nodes.set( m_goal_x, m_goal_y, goal );
+
+    const QueueEntry entry = { goal.queued_key, uint32_t( m_goal_y * map.width() + m_goal_x ) };
+    m_queue.push_back( entry );
+}
+
+/*
+ * Nodes are expanded in the order of the cost of the best path through
+ * them from the robot, and then of their own cost. Since the robot moves
+ * and the heuristic is measured from it, the keys queued earlier are
+ * made comparable by adding how far the robot has moved since.
+ */
+uint64_t DStarLiteAlgorithm::key( const Node& node, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y ) const
+{
+    const uint32_t cost = std::min( node.g, node.rhs );
+    const uint32_t estimate = cost + distance( start_x, start_y, x, y ) + m_key_modifier;
+
+    return (uint64_t( estimate ) << 32) | cost;
+}
+
+/* Which of the eight neighbours of a block are free, as bits in the order of the directions, and the block itself as the ninth. */
+static unsigned free_neighbours( const TiledArray2d< ObstacleType >& map, const unsigned x, const unsigned y )
+{
+    unsigned mask = 0;
+    for( unsigned direction = 0; direction < 8; ++direction )
+    {
+        const int neighbour_x = int( x ) + direction_x[ direction ];
+        const int neighbour_y = int( y ) + direction_y[ direction ];
+        if( neighbour_x >= 0 && neighbour_y >= 0 && neighbour_x < int( map.width() ) && neighbour_y < int( map.height() ) && map.at( neighbour_x, neighbour_y ) != ObstacleType::Wall )
+            mask |= 1 << direction;
+    }
+
+    if( map.at( x, y ) != ObstacleType::Wall )
+        mask |= 1 << 8;
+
+    return mask;
+}
+
+/*
+ * Cost of a step from a block in a given direction, without cutting the
+ * corners of walls. It's the same both ways, since the same blocks have
+ * to be free for either.
+ */
+static uint32_t step_cost( const unsigned mask, const unsigned direction )
+{
+    if( !(mask & (1 << 8)) || !(mask & (1 << direction)) )
+        return infinity;
+
+    if( direction < 4 )
+        return straight_cost;
+
+    const unsigned sides = (1 << (direction - 4)) | (1 << ((direction - 3) % 4));
+    if( (mask & sides) != sides )
+        return infinity;
+
+    return diagonal_cost;
+}
+
+/* Queues a node if it's inconsistent, or marks it as not queued if it isn't; the node still has to be stored. */
+void DStarLiteAlgorithm::enqueue( Node& node, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y )
+{
+    if( node.g == node.rhs )
+    {
+        node.queued_key = not_queued;
+        return;
+    }
+
+    const uint64_t new_key = key( node, x, y, start_x, start_y );
+    if( node.queued_key == new_key )
+        return;
+
+    node.queued_key = new_key;
+
+    const QueueEntry entry = { new_key, uint32_t( y * m_nodes.width() + x ) };
+    m_queue.push_back( entry );
+    std::push_heap( m_queue.begin(), m_queue.end(), std::greater< QueueEntry >() );
+}
+
+void DStarLiteAlgorithm::update_node( const TiledArray2d< ObstacleType >& map, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y )
+{
+    Node node = m_nodes.at( x, y );
+
+    if( x != m_goal_x || y != m_goal_y )
+    {
+        const unsigned mask = free_neighbours( map, x, y );
+
+        node.rhs = infinity;
+        for( unsigned direction = 0; direction < 8; ++direction )
+        {
+            const uint32_t step = step_cost( mask, direction );
+            if( step == infinity )
+                continue;
+
+            const uint32_t g = m_nodes.at( x + direction_x[ direction ], y + direction_y[ direction ] ).g;
+            node.rhs = std::min( node.rhs, std::min( g + step, infinity ) );
+        }
+    }
+
+    enqueue( node, x, y, start_x, start_y );
+    m_nodes.set( x, y, node );
+}
+
+/* Everything whose cost depends on whenever a given block is free. */
+void DStarLiteAlgorithm::update_around( const TiledArray2d< ObstacleType >& map, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y )
+{
+    update_node( map, x, y, start_x, start_y );
+    for( unsigned direction = 0; direction < 8; ++direction )
+    {
+        const int neighbour_x = int( x ) + direction_x[ direction ];
+        const int neighbour_y = int( y ) + direction_y[ direction ];
+        if( neighbour_x >= 0 && neighbour_y >= 0 && neighbour_x < int( map.width() ) && neighbour_y < int( map.height() ) )
+            update_node( map, neighbour_x, neighbour_y, start_x, start_y );
+    }
+}
+
+/* Takes every node expanded out of @a io_budget, and stops once it runs out; the queue is left as it is, so the next run carries on from there. */
+bool DStarLiteAlgorithm::compute_shortest_path( const TiledArray2d< ObstacleType >& map, const unsigned start_x, const unsigned start_y, std::size_t& io_budget )
+{
+    const unsigned width = map.width();
+    for( ;; )
+    {
+        /* Drop the entries of nodes which have since been requeued or became consistent. */
+        while( !m_queue.empty() && m_nodes.at( m_queue.front().index % width, m_queue.front().index / width ).queued_key != m_queue.front().key )
+        {
+            std::pop_heap( m_queue.begin(), m_queue.end(), std::greater< QueueEntry >() );
+            m_queue.pop_back();
+        }
+
+        if( m_queue.empty() )
+            return true;
+
+        const Node start = m_nodes.at( start_x, start_y );
+        if( m_queue.front().key >= key( start, start_x, start_y, start_x, start_y ) && start.g == start.rhs )
+            return true;
+
+        if( io_budget == 0 )
+            return false;
+
+        io_budget--;
+
+        const QueueEntry entry = m_queue.front();
+        std::pop_heap( m_queue.begin(), m_queue.end(), std::greater< QueueEntry >() );
+        m_queue.pop_back();
+
+        const unsigned x = entry.index % width;
+        const unsigned y = entry.index / width;
+        Node node = m_nodes.at( x, y );
+        node.queued_key = not_queued;
+
+        const uint64_t new_key = key( node, x, y, start_x, start_y );
+        if( entry.key < new_key )
+        {
+            enqueue( node, x, y, start_x, start_y );
+            m_nodes.set( x, y, node );
+            continue;
+        }
+
+        const unsigned mask = free_neighbours( map, x, y );
+        if( node.g > node.rhs )
+        {
+            /* The node got cheaper, which can only make its neighbours cheaper too. */
+            node.g = node.rhs;
+            m_nodes.set( x, y, node );
+
+            for( unsigned direction = 0; direction < 8; ++direction )
+            {
+                const uint32_t step = step_cost( mask, direction );
+                if( step == infinity )
+                    continue;
+
+                const unsigned neighbour_x = x + direction_x[ direction ];
+                const unsigned neighbour_y = y + direction_y[ direction ];
+                if( neighbour_x == m_goal_x && neighbour_y == m_goal_y )
+                    continue;
+
+                Node neighbour = m_nodes.at( neighbour_x, neighbour_y );
+                if( node.g + step >= neighbour.rhs )
+                    continue;
+
+                neighbour.rhs = node.g + step;
+                enqueue( neighbour, neighbour_x, neighbour_y, start_x, start_y );
+                m_nodes.set( neighbour_x, neighbour_y, neighbour );
+            }
+        }
+        else
+        {
+            /* The node got dearer; only the neighbours whose best way on went through it have to look for another one. */
+            const uint32_t old_g = node.g;
+            node.g = infinity;
+            enqueue( node, x, y, start_x, start_y );
+            m_nodes.set( x, y, node );
+
+            for( unsigned direction = 0; direction < 8; ++direction )
+            {
+                const uint32_t step = step_cost( mask, direction );
+                if( step == infinity )
+                    continue;
+
+                const unsigned neighbour_x = x + direction_x[ direction ];
+                const unsigned neighbour_y = y + direction_y[ direction ];
+                if( m_nodes.at( neighbour_x, neighbour_y ).rhs == std::min( old_g + step, infinity ) )
+                    update_node( map, neighbour_x, neighbour_y, start_x, start_y );
+            }
+        }
+    }
+}
+
+float DStarLiteAlgorithm::run( const Robot& robot, const float elapsed )
+{
+    const TiledArray2d< ObstacleType >& map = robot.obstacle_map();
+    const unsigned start_x = robot.x();
+    const unsigned start_y = robot.y();
+
+    if( !m_is_initialized || m_goal_x != robot.goal_x() || m_goal_y != robot.goal_y() || robot.has_lost_knowledge_changes() )
+        reset( robot );
+    else
+    {
+        if( start_x != m_last_x || start_y != m_last_y )
+        {
+            m_key_modifier += distance( m_last_x, m_last_y, start_x, start_y );
+            m_last_x = start_x;
+            m_last_y = start_y;
+        }
+
+        for( const auto& change: robot.knowledge_changes() )
+            update_around( map, change.first, change.second, start_x, start_y );
+    }
+
+    /* The costs around the robot aren't worked out yet; it waits until they are. */
+    std::size_t budget = planning_budget();
+    const bool is_done = compute_shortest_path( map, start_x, start_y, budget );
+    spend_planning_budget( planning_budget() - budget, !is_done );
+    if( !is_done )
+        return NAN;
+
+    const float x = start_x + robot.frac_x();
+    const float y = start_y + robot.frac_y();
+
+    float target_x = robot.goal_x() + 0.5f;
+    float target_y = robot.goal_y() + 0.5f;
+
+    /* Step to the neighbour with the cheapest way on; without one, head straight for the goal. */
+    if( start_x != m_goal_x || start_y != m_goal_y )
+    {
+        const unsigned mask = free_neighbours( map, start_x, start_y );
+
+        uint32_t best = infinity;
+        for( unsigned direction = 0; direction < 8; ++direction )
+        {
+            const uint32_t step = step_cost( mask, direction );
+            if( step == infinity )
+                continue;
+
+            const uint32_t total = step + m_nodes.at( start_x + direction_x[ direction ], start_y + direction_y[ direction ] ).g;
+            if( total < best )
+            {
+                best = total;
+                target_x = start_x + direction_x[ direction ] + 0.5f;
+                target_y = start_y + direction_y[ direction ] + 0.5f;
+            }
+        }
+    }
+
+    return atan2f( target_y - y, target_x - x );
+}
@@ -0,0 +1,76 @@
+#ifndef DSTARLITEALGORITHM_H
+#define DSTARLITEALGORITHM_H
+
+#include "routingalgorithm.h"
+#include "tiledarray2d.h"
+#include "scene.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Follows the shortest path to the goal through the blocks the
+ *        robot knows about, like AStarAlgorithm, but keeps its search
+ *        between the runs and only repairs the part of it affected by
+ *        what the robot has learned since, using D* Lite.
+ *
+ * The search goes from the goal towards the robot, so that the costs
+ * it has already worked out stay valid as the robot moves. They're kept
+ * in a sparse array, so a robot only pays for the area it searched.
+ *
+ * Repairing more of the search than the planning budget allows is left
+ * for the following runs, while the robot waits where it is.
+ */
+class DStarLiteAlgorithm : public RoutingAlgorithm
+{
+    struct Node
+    {
+        /* Cost to the goal, and the one-step lookahead of it. */
+        uint32_t g;
+        uint32_t rhs;
+
+        /* The key the node is queued with, if it's queued. */
+        uint64_t queued_key;
+
+        Node();
+        bool operator ==( const Node& node ) const;
+    };
+
+    struct QueueEntry
+    {
+        uint64_t key;
+        uint32_t index;
+
+        bool operator >( const QueueEntry& entry ) const;
+    };
+
+    TiledArray2d< Node > m_nodes;
+
+    /* A binary heap with the smallest key first; entries whose node has moved on are skipped. */
+    std::vector< QueueEntry > m_queue;
+
+    bool m_is_initialized;
+    unsigned m_goal_x;
+    unsigned m_goal_y;
+
+    /* Where the robot was when the keys were last adjusted, and by how much they were. */
+    unsigned m_last_x;
+    unsigned m_last_y;
+    uint32_t m_key_modifier;
+
+    void reset( const Robot& robot );
+    uint64_t key( const Node& node, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y ) const;
+    void enqueue( Node& node, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y );
+    void update_node( const TiledArray2d< ObstacleType >& map, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y );
+    void update_around( const TiledArray2d< ObstacleType >& map, const unsigned x, const unsigned y, const unsigned start_x, const unsigned start_y );
+    bool compute_shortest_path( const TiledArray2d< ObstacleType >& map, const unsigned start_x, const unsigned start_y, std::size_t& io_budget );
+
+    public:
+        explicit DStarLiteAlgorithm();
+        virtual ~DStarLiteAlgorithm();
+
+        virtual void initialize( const Robot& robot ) override;
+        virtual float run( const Robot& robot, const float elapsed ) override;
+};
+
+#endif // DSTARLITEALGORITHM_H
@@ -1,11 +1,12 @@
 #include "dummyalgorithm.h"
 #include "routingalgorithmregistry.h"
+#include "specializedsimulation.h"
 #include "robot.h"
 
-#include <math.h>
-
 static const StaticAlgorithmRegistration registrar( "Dummy", [](){
     return std::unique_ptr< RoutingAlgorithm >( new DummyAlgorithm() );
+}, []( const std::shared_ptr< Scene >& scene ){
+    return std::unique_ptr< Simulation >( new SpecializedSimulation< DummyAlgorithm >( scene ) );
 } );
 
 DummyAlgorithm::DummyAlgorithm()
@@ -23,15 +24,12 @@ void DummyAlgorithm::initialize( const Robot& robot )
 
 float DummyAlgorithm::run( const Robot& robot, const float elapsed )
 {
-    const float x = robot.x() + robot.frac_x();
-    const float y = robot.y() + robot.frac_y();
-
-    const float goal_x = robot.goal_x() + 0.5f;
-    const float goal_y = robot.goal_y() + 0.5f;
-
-    const float dx = goal_x - x;
-    const float dy = goal_y - y;
+    return steer( robot.x(), robot.y(), robot.frac_x(), robot.frac_y(), robot.goal_x(), robot.goal_y() );
+}
 
-    const float angle = atan2f( dy, dx );
-    return angle;
+/* The same as run(), only straight over the arrays, so that it's one tight loop for the whole batch. */
+void DummyAlgorithm::run_batch( const RoutingBatch& batch, const float elapsed )
+{
+    for( std::size_t i = 0; i < batch.size; ++i )
+        batch.angle[ i ] = steer( batch.x[ i ], batch.y[ i ], batch.frac_x[ i ], batch.frac_y[ i ], batch.goal_x[ i ], batch.goal_y[ i ] );
 }
@@ -3,6 +3,8 @@
 
 #include "routingalgorithm.h"
 
+#include <math.h>
+
 class DummyAlgorithm : public RoutingAlgorithm
 {
     public:
@@ -11,6 +13,20 @@ class DummyAlgorithm : public RoutingAlgorithm
 
         virtual void initialize( const Robot& robot ) override;
         virtual float run( const Robot& robot, const float elapsed ) override;
+        virtual void run_batch( const RoutingBatch& batch, const float elapsed ) override;
+
+        /**
+         * @return Direction from a robot at a given position straight
+         *         to the middle of its goal; all there is to run().
+         */
+        static inline float steer( const unsigned x, const unsigned y, const float frac_x, const float frac_y,
+                                   const unsigned goal_x, const unsigned goal_y )
+        {
+            const float dx = (goal_x + 0.5f) - (x + frac_x);
+            const float dy = (goal_y + 0.5f) - (y + frac_y);
+
+            return atan2f( dy, dx );
+        }
 };
 
 #endif // DUMMYALGORITHM_H
@@ -0,0 +1,101 @@
+#include "flowfieldalgorithm.h"
+#include "routingalgorithmregistry.h"
+#include "flowfieldcache.h"
+#include "robot.h"
+#include "scene.h"
+
+#include <math.h>
+
+static const StaticAlgorithmRegistration registrar( "Flow field", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new FlowFieldAlgorithm() );
+} );
+
+/* The eight neighbours; the straight ones first, then every diagonal one between two of them. */
+static const int direction_x[ 8 ] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int direction_y[ 8 ] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+FlowFieldAlgorithm::FlowFieldAlgorithm() :
+    m_field_generation( 0 )
+{
+}
+
+FlowFieldAlgorithm::~FlowFieldAlgorithm()
+{
+}
+
+void FlowFieldAlgorithm::initialize( const Robot& robot )
+{
+}
+
+float FlowFieldAlgorithm::run( const Robot& robot, const float elapsed )
+{
+    const Scene& scene = robot.scene();
+    const int robot_x = robot.x();
+    const int robot_y = robot.y();
+
+    const float x = robot_x + robot.frac_x();
+    const float y = robot_y + robot.frac_y();
+
+    float target_x = robot.goal_x() + 0.5f;
+    float target_y = robot.goal_y() + 0.5f;
+
+    /*
+     * Kept between the calls, so that getting it doesn't have to take the
+     * cache's lock; once the cache drops it, it's let go of as well, so
+     * that it isn't kept alive, without being updated, by every robot.
+     */
+    FlowFieldCache& cache = scene.flow_field_cache();
+    const unsigned generation = cache.generation();
+    if( !m_field || generation != m_field_generation || m_field->goal_x() != robot.goal_x() || m_field->goal_y() != robot.goal_y() )
+    {
+        m_field = cache.field( robot.goal_x(), robot.goal_y() );
+        m_field_generation = generation;
+    }
+    else
+        cache.mark_used( *m_field );
+
+    const FlowField* field = m_field.get();
+
+    /* Without a way to the goal it's still better to head towards it than to stand still. */
+    uint32_t best = field ? field->at( robot_x, robot_y ) : FlowField::unreachable;
+    if( best == FlowField::unreachable || best == 0 )
+        return atan2f( target_y - y, target_x - x );
+
+    auto is_free = [&scene]( const int x, const int y ) {
+        return x >= 0 && y >= 0 && x < int( scene.width() ) && y < int( scene.height() ) && !scene.wall_plane().get( x, y );
+    };
+
+    bool is_straight_free[ 4 ];
+    for( unsigned direction = 0; direction < 8; ++direction )
+    {
+        const int next_x = robot_x + direction_x[ direction ];
+        const int next_y = robot_y + direction_y[ direction ];
+        uint32_t step;
+        if( direction < 4 )
+        {
+            is_straight_free[ direction ] = is_free( next_x, next_y );
+            if( !is_straight_free[ direction ] )
+                continue;
+
+            step = FlowField::straight_cost;
+        }
+        else
+        {
+            /* A diagonal step is only allowed when both of the straight ones next to it are. */
+            if( !is_straight_free[ direction - 4 ] || !is_straight_free[ (direction - 3) % 4 ] || !is_free( next_x, next_y ) )
+                continue;
+
+            step = FlowField::diagonal_cost;
+        }
+
+        const uint32_t cost = field->at( next_x, next_y );
+        if( cost != FlowField::unreachable && cost + step <= best )
+        {
+            best = cost + step;
+            target_x = next_x + 0.5f;
+            target_y = next_y + 0.5f;
+        }
+    }
+
+    return atan2f( target_y - y, target_x - x );
+}
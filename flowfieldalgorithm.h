@@ -0,0 +1,33 @@
+#ifndef FLOWFIELDALGORITHM_H
+#define FLOWFIELDALGORITHM_H
+
+#include "routingalgorithm.h"
+
+#include <memory>
+
+class FlowField;
+
+/**
+ * @brief Steps to whichever neighbouring block is the closest to the
+ *        goal according to the goal's flow field, which all of the
+ *        robots heading for the same goal share through the Scene's
+ *        FlowFieldCache; nothing is searched for per robot.
+ *
+ * Like HierarchicalAlgorithm this one goes by the actual walls of the
+ * scene instead of what the robot has seen, and ignores other robots.
+ */
+class FlowFieldAlgorithm : public RoutingAlgorithm
+{
+    /* The field of the goal, as long as the cache's generation is still the same. */
+    std::shared_ptr< const FlowField > m_field;
+    unsigned m_field_generation;
+
+    public:
+        explicit FlowFieldAlgorithm();
+        virtual ~FlowFieldAlgorithm();
+
+        virtual void initialize( const Robot& robot ) override;
+        virtual float run( const Robot& robot, const float elapsed ) override;
+};
+
+#endif // FLOWFIELDALGORITHM_H
@@ -0,0 +1,500 @@
+#include "flowfieldcache.h"
+#include "bitplane.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <new>
+
+const uint32_t FlowField::unreachable;
+const uint32_t FlowField::straight_cost;
+const uint32_t FlowField::diagonal_cost;
+
+/* Enough for a few fields of even the biggest maps. */
+static const std::size_t default_memory_limit = std::size_t( 256 ) * 1024 * 1024;
+
+/* The eight neighbours; the straight ones first, then every diagonal one between two of them. */
+static const int direction_x[ 8 ] = { 1, 0, -1, 0, 1, -1, -1, 1 };
+static const int direction_y[ 8 ] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+/*
+ * The steps only ever cost one of two small amounts, so instead of a heap
+ * the blocks waiting to be gone through are kept in a ring of buckets,
+ * one for every cost they could be waiting at.
+ */
+FlowField::FlowField( const BitPlane& walls, const unsigned goal_x, const unsigned goal_y ) :
+    m_width( walls.width() ),
+    m_height( walls.height() ),
+    m_goal_x( goal_x ),
+    m_goal_y( goal_y ),
+    m_costs( std::size_t( m_width ) * m_height, unreachable ),
+    m_last_use( 0 )
+{
+    assert( goal_x < m_width && goal_y < m_height );
+
+    auto is_free = [&]( const int x, const int y ) {
+        return x >= 0 && y >= 0 && x < int( m_width ) && y < int( m_height ) && !walls.get( x, y );
+    };
+
+    if( !is_free( goal_x, goal_y ) )
+        return;
+
+    const unsigned bucket_count = diagonal_cost + 1;
+    std::vector< uint32_t > buckets[ bucket_count ];
+
+    m_costs[ goal_y * m_width + goal_x ] = 0;
+    buckets[ 0 ].push_back( goal_y * m_width + goal_x );
+
+    std::size_t waiting = 1;
+    for( uint32_t cost = 0; waiting > 0; ++cost )
+    {
+        std::vector< uint32_t >& bucket = buckets[ cost % bucket_count ];
+        for( std::size_t i = 0; i < bucket.size(); ++i )
+        {
+            const uint32_t index = bucket[ i ];
+            waiting--;
+
+            /* Reached again more cheaply after it was put in here. */
+            if( m_costs[ index ] != cost )
+                continue;
+
+            const int x = index % m_width;
+            const int y = index / m_width;
+
+            bool is_straight_free[ 4 ];
+            for( unsigned direction = 0; direction < 8; ++direction )
+            {
+                const int next_x = x + direction_x[ direction ];
+                const int next_y = y + direction_y[ direction ];
+                uint32_t next_cost;
+                if( direction < 4 )
+                {
+                    is_straight_free[ direction ] = is_free( next_x, next_y );
+                    if( !is_straight_free[ direction ] )
+                        continue;
+
+                    next_cost = cost + straight_cost;
+                }
+                else
+                {
+                    /* A diagonal step is only allowed when both of the straight ones next to it are. */
+                    if( !is_straight_free[ direction - 4 ] || !is_straight_free[ (direction - 3) % 4 ] || !is_free( next_x, next_y ) )
+                        continue;
+
+                    next_cost = cost + diagonal_cost;
+                }
+
+                uint32_t& next = m_costs[ next_y * m_width + next_x ];
+                if( next_cost >= next )
+                    continue;
+
+                next = next_cost;
+                buckets[ next_cost % bucket_count ].push_back( next_y * m_width + next_x );
+                waiting++;
+            }
+        }
+
+        bucket.clear();
+    }
+}
+
+unsigned FlowField::goal_x() const
+{
+    return m_goal_x;
+}
+
+unsigned FlowField::goal_y() const
+{
+    return m_goal_y;
+}
+
+bool FlowField::is_step_allowed( const BitPlane& walls, const unsigned x, const unsigned y, const unsigned direction ) const
+{
+    auto is_free = [&]( const int x, const int y ) {
+        return x >= 0 && y >= 0 && x < int( m_width ) && y < int( m_height ) && !walls.get( x, y );
+    };
+
+    if( !is_free( x + direction_x[ direction ], y + direction_y[ direction ] ) )
+        return false;
+
+    if( direction < 4 )
+        return true;
+
+    /* A diagonal step is only allowed when both of the straight ones next to it are. */
+    const unsigned first = direction - 4;
+    const unsigned second = (direction - 3) % 4;
+    return is_free( x + direction_x[ first ], y + direction_y[ first ] ) && is_free( x + direction_x[ second ], y + direction_y[ second ] );
+}
+
+/* The blocks whose costs are being worked out again, cheapest first; the cost is in the upper half. */
+static thread_local std::vector< uint64_t > repair_queue;
+
+static void push_repair( const uint32_t cost, const uint32_t index )
+{
+    repair_queue.push_back( (uint64_t( cost ) << 32) | index );
+    std::push_heap( repair_queue.begin(), repair_queue.end(), std::greater< uint64_t >() );
+}
+
+static uint64_t pop_repair()
+{
+    std::pop_heap( repair_queue.begin(), repair_queue.end(), std::greater< uint64_t >() );
+    const uint64_t entry = repair_queue.back();
+    repair_queue.pop_back();
+    return entry;
+}
+
+/*
+ * A new wall can only make the costs higher, and only of the blocks
+ * whose every shortest path went through the wall or past its corners.
+ * Those are found by going through the blocks around the wall, and then
+ * the ones downhill from every block found, cheapest first: a block
+ * stays as it is if it's still exactly one step more than a neighbour
+ * which does. The rest are then worked out again from their neighbours
+ * which weren't affected, like in the constructor.
+ */
+void FlowField::add_wall( const BitPlane& walls, const unsigned x, const unsigned y )
+{
+    const uint32_t wall_index = y * m_width + x;
+    repair_queue.clear();
+
+    std::vector< uint32_t > invalidated;
+    if( m_costs[ wall_index ] != unreachable )
+    {
+        m_costs[ wall_index ] = unreachable;
+        invalidated.push_back( wall_index );
+    }
+
+    for( unsigned direction = 0; direction < 8; ++direction )
+    {
+        const int next_x = int( x ) + direction_x[ direction ];
+        const int next_y = int( y ) + direction_y[ direction ];
+        if( next_x < 0 || next_y < 0 || next_x >= int( m_width ) || next_y >= int( m_height ) )
+            continue;
+
+        const uint32_t index = next_y * m_width + next_x;
+        if( m_costs[ index ] != unreachable )
+            push_repair( m_costs[ index ], index );
+    }
+
+    while( !repair_queue.empty() )
+    {
+        const uint32_t index = uint32_t( pop_repair() );
+        const uint32_t cost = m_costs[ index ];
+
+        /* Already found to be affected. */
+        if( cost == unreachable || cost == 0 )
+            continue;
+
+        const unsigned block_x = index % m_width;
+        const unsigned block_y = index / m_width;
+
+        bool is_kept = false;
+        for( unsigned direction = 0; direction < 8 && !is_kept; ++direction )
+        {
+            if( !is_step_allowed( walls, block_x, block_y, direction ) )
+                continue;
+
+            const uint32_t step = direction < 4 ? straight_cost : diagonal_cost;
+            const uint32_t previous = m_costs[ (block_y + direction_y[ direction ]) * m_width + block_x + direction_x[ direction ] ];
+            is_kept = previous != unreachable && previous + step == cost;
+        }
+
+        if( is_kept )
+            continue;
+
+        m_costs[ index ] = unreachable;
+        invalidated.push_back( index );
+
+        for( unsigned direction = 0; direction < 8; ++direction )
+        {
+            const int next_x = int( block_x ) + direction_x[ direction ];
+            const int next_y = int( block_y ) + direction_y[ direction ];
+            if( next_x < 0 || next_y < 0 || next_x >= int( m_width ) || next_y >= int( m_height ) )
+                continue;
+
+            const uint32_t next_index = next_y * m_width + next_x;
+            const uint32_t step = direction < 4 ? straight_cost : diagonal_cost;
+            if( m_costs[ next_index ] == cost + step )
+                push_repair( cost + step, next_index );
+        }
+    }
+
+    for( const uint32_t index : invalidated )
+    {
+        const unsigned block_x = index % m_width;
+        const unsigned block_y = index / m_width;
+        if( walls.get( block_x, block_y ) )
+            continue;
+
+        uint32_t best = unreachable;
+        for( unsigned direction = 0; direction < 8; ++direction )
+        {
+            if( !is_step_allowed( walls, block_x, block_y, direction ) )
+                continue;
+
+            const uint32_t step = direction < 4 ? straight_cost : diagonal_cost;
+            const uint32_t previous = m_costs[ (block_y + direction_y[ direction ]) * m_width + block_x + direction_x[ direction ] ];
+            if( previous != unreachable && previous + step < best )
+                best = previous + step;
+        }
+
+        if( best != unreachable )
+        {
+            m_costs[ index ] = best;
+            push_repair( best, index );
+        }
+    }
+
+    lower_costs( walls );
+}
+
+/*
+ * A removed wall can only make the costs lower, so it's enough to start
+ * from the blocks around it and go on only while the costs keep getting
+ * lower.
+ */
+void FlowField::remove_wall( const BitPlane& walls, const unsigned x, const unsigned y )
+{
+    repair_queue.clear();
+
+    if( x == m_goal_x && y == m_goal_y )
+        m_costs[ y * m_width + x ] = 0;
+
+    for( int dy = -1; dy <= 1; ++dy )
+    {
+        for( int dx = -1; dx <= 1; ++dx )
+        {
+            const int block_x = int( x ) + dx;
+            const int block_y = int( y ) + dy;
+            if( block_x < 0 || block_y < 0 || block_x >= int( m_width ) || block_y >= int( m_height ) )
+                continue;
+
+            const uint32_t index = block_y * m_width + block_x;
+            if( m_costs[ index ] != unreachable )
+                push_repair( m_costs[ index ], index );
+        }
+    }
+
+    lower_costs( walls );
+}
+
+void FlowField::lower_costs( const BitPlane& walls )
+{
+    while( !repair_queue.empty() )
+    {
+        const uint64_t entry = pop_repair();
+        const uint32_t index = uint32_t( entry );
+        const uint32_t cost = uint32_t( entry >> 32 );
+
+        /* Reached again more cheaply after it was put in. */
+        if( m_costs[ index ] != cost )
+            continue;
+
+        const unsigned block_x = index % m_width;
+        const unsigned block_y = index / m_width;
+        for( unsigned direction = 0; direction < 8; ++direction )
+        {
+            if( !is_step_allowed( walls, block_x, block_y, direction ) )
+                continue;
+
+            const uint32_t next_cost = cost + (direction < 4 ? straight_cost : diagonal_cost);
+            uint32_t& next = m_costs[ (block_y + direction_y[ direction ]) * m_width + block_x + direction_x[ direction ] ];
+            if( next_cost >= next )
+                continue;
+
+            next = next_cost;
+            push_repair( next_cost, (block_y + direction_y[ direction ]) * m_width + block_x + direction_x[ direction ] );
+        }
+    }
+}
+
+std::size_t FlowField::memory_usage() const
+{
+    return m_costs.size() * sizeof( uint32_t );
+}
+
+FlowFieldCache::FlowFieldCache( const BitPlane& walls ) :
+    m_walls( walls ),
+    m_memory_limit( default_memory_limit ),
+    m_memory_usage( 0 ),
+    m_clock( 0 ),
+    m_generation( 0 )
+{
+}
+
+std::size_t FlowFieldCache::memory_limit() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_memory_limit;
+}
+
+void FlowFieldCache::set_memory_limit( const std::size_t limit )
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    m_memory_limit = limit;
+    evict( 0xffffffff );
+}
+
+std::size_t FlowFieldCache::memory_usage() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_memory_usage;
+}
+
+std::size_t FlowFieldCache::size() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_entries.size();
+}
+
+void FlowFieldCache::erase( const uint32_t goal )
+{
+    auto found = m_entries.find( goal );
+    m_memory_usage -= found->second.memory_usage;
+    m_entries.erase( found );
+    m_generation.fetch_add( 1, std::memory_order_release );
+}
+
+/*
+ * Drops the fields which were used the longest time ago; the ones still
+ * being worked out count as used when they were put in.
+ */
+void FlowFieldCache::evict( const uint32_t kept_goal )
+{
+    while( m_memory_usage > m_memory_limit && m_entries.size() > 1 )
+    {
+        uint32_t oldest_goal = kept_goal;
+        uint64_t oldest_use = 0;
+        for( const auto& entry : m_entries )
+        {
+            if( entry.first == kept_goal )
+                continue;
+
+            uint64_t last_use = entry.second.added;
+            if( entry.second.field.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready )
+            {
+                const std::shared_ptr< FlowField >& field = entry.second.field.get();
+                last_use = field ? field->m_last_use.load( std::memory_order_relaxed ) : 0;
+            }
+
+            if( oldest_goal == kept_goal || last_use < oldest_use || (last_use == oldest_use && entry.first < oldest_goal) )
+            {
+                oldest_goal = entry.first;
+                oldest_use = last_use;
+            }
+        }
+
+        erase( oldest_goal );
+    }
+}
+
+/*
+ * A missing field is put in right away, as a promise, and then worked
+ * out after letting go of the lock, so that the robots whose fields are
+ * already kept don't have to wait for it. A field dropped before it's
+ * done is still handed to whoever is waiting for it.
+ */
+std::shared_ptr< const FlowField > FlowFieldCache::field( const unsigned goal_x, const unsigned goal_y )
+{
+    const uint32_t goal = goal_y * m_walls.width() + goal_x;
+
+    std::unique_lock< std::mutex > lock( m_mutex );
+    auto found = m_entries.find( goal );
+    if( found != m_entries.end() )
+    {
+        const std::shared_future< std::shared_ptr< FlowField > > future = found->second.field;
+        lock.unlock();
+
+        const std::shared_ptr< FlowField > field = future.get();
+        if( field )
+            mark_used( *field );
+
+        return field;
+    }
+
+    std::promise< std::shared_ptr< FlowField > > promise;
+    const uint64_t added = m_clock.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    const Entry entry = { promise.get_future().share(), std::size_t( m_walls.width() ) * m_walls.height() * sizeof( uint32_t ), added };
+    m_entries.insert( std::make_pair( goal, entry ) );
+    m_memory_usage += entry.memory_usage;
+    evict( goal );
+    lock.unlock();
+
+    std::shared_ptr< FlowField > field;
+    try
+    {
+        field = std::make_shared< FlowField >( m_walls, goal_x, goal_y );
+        field->m_last_use.store( added, std::memory_order_relaxed );
+    }
+    catch( const std::bad_alloc& )
+    {
+        /* Whoever is waiting for it gets nothing as well, and the next one to want it tries again. */
+        promise.set_value( nullptr );
+
+        lock.lock();
+        found = m_entries.find( goal );
+        if( found != m_entries.end() && found->second.added == added )
+            erase( goal );
+
+        return nullptr;
+    }
+
+    promise.set_value( field );
+    return field;
+}
+
+/*
+ * A wall changing can only affect the fields of the goals which could
+ * be reached from next to it, or which it is on; the others stay exactly
+ * the same.
+ */
+void FlowFieldCache::update( const unsigned x, const unsigned y )
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    std::vector< uint32_t > failed;
+    for( auto& entry : m_entries )
+    {
+        /* Nobody is getting fields while the cache is updated, so every one of them is done. */
+        FlowField& field = *entry.second.field.get();
+
+        bool is_affected = field.goal_x() == x && field.goal_y() == y;
+        for( int dy = -1; dy <= 1 && !is_affected; ++dy )
+        {
+            for( int dx = -1; dx <= 1 && !is_affected; ++dx )
+            {
+                const int neighbour_x = int( x ) + dx;
+                const int neighbour_y = int( y ) + dy;
+                if( neighbour_x >= 0 && neighbour_y >= 0 && neighbour_x < int( m_walls.width() ) && neighbour_y < int( m_walls.height() ) )
+                    is_affected = field.at( neighbour_x, neighbour_y ) != FlowField::unreachable;
+            }
+        }
+
+        if( !is_affected )
+            continue;
+
+        try
+        {
+            if( m_walls.get( x, y ) )
+                field.add_wall( m_walls, x, y );
+            else
+                field.remove_wall( m_walls, x, y );
+        }
+        catch( const std::bad_alloc& )
+        {
+            /* Half worked out, so it can't be kept. */
+            failed.push_back( entry.first );
+        }
+    }
+
+    for( const uint32_t goal : failed )
+        erase( goal );
+}
+
+void FlowFieldCache::clear()
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    m_entries.clear();
+    m_memory_usage = 0;
+    m_generation.fetch_add( 1, std::memory_order_release );
+}
@@ -0,0 +1,194 @@
+#ifndef FLOWFIELDCACHE_H
+#define FLOWFIELDCACHE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <unordered_map>
+#include <stdint.h>
+
+class BitPlane;
+
+/**
+ * @brief Cost of the shortest path from every block of a map to one goal,
+ *        moving between the eight neighbouring blocks without cutting the
+ *        corners of walls; following the costs downhill from any block
+ *        leads to the goal.
+ */
+class FlowField
+{
+    unsigned m_width;
+    unsigned m_height;
+    unsigned m_goal_x;
+    unsigned m_goal_y;
+    std::vector< uint32_t > m_costs;
+
+    /* When the field was last used, by the clock of the FlowFieldCache which keeps it. */
+    mutable std::atomic< uint64_t > m_last_use;
+
+    friend class FlowFieldCache;
+
+    bool is_step_allowed( const BitPlane& walls, const unsigned x, const unsigned y, const unsigned direction ) const;
+    void add_wall( const BitPlane& walls, const unsigned x, const unsigned y );
+    void remove_wall( const BitPlane& walls, const unsigned x, const unsigned y );
+    void lower_costs( const BitPlane& walls );
+
+    public:
+        /* Cost of the blocks from which the goal can't be reached. */
+        static const uint32_t unreachable = 0xffffffff;
+
+        /* Costs of a step, scaled so that they stay integers. */
+        static const uint32_t straight_cost = 10;
+        static const uint32_t diagonal_cost = 14;
+
+        /**
+         * @brief Works out the costs over the walls of a given plane.
+         */
+        explicit FlowField( const BitPlane& walls, const unsigned goal_x, const unsigned goal_y );
+
+        FlowField( const FlowField& ) = delete;
+        FlowField& operator =( const FlowField& ) = delete;
+
+        /**
+         * @return Horizontal position of the goal.
+         */
+        unsigned goal_x() const;
+
+        /**
+         * @return Vertical position of the goal.
+         */
+        unsigned goal_y() const;
+
+        /**
+         * @return Cost of the shortest path from a given block to the goal.
+         */
+        uint32_t at( const unsigned x, const unsigned y ) const
+        {
+            return m_costs[ y * m_width + x ];
+        }
+
+        /**
+         * @return Number of bytes the field takes up.
+         */
+        std::size_t memory_usage() const;
+};
+
+/**
+ * @brief The flow fields of the goals robots are heading for, shared
+ *        between all of them, so that robots with the same goal don't
+ *        each have to search for the way to it.
+ *
+ * The fields are worked out on first use and kept until they're the
+ * least recently used ones when the memory limit is hit. When a wall
+ * changes, only the part of every field it affects is worked out again,
+ * in place, which is also seen by whoever holds onto the field.
+ *
+ * Any number of threads can get fields at the same time, as long as
+ * the cache isn't being updated. A field is worked out without holding
+ * the cache's lock, so a robot waits only if it wants that very field.
+ * Getting a field does take the lock, so a robot which keeps using the
+ * same one should rather hold onto it, for as long as generation() stays
+ * the same, and only let the cache know with mark_used().
+ */
+class FlowFieldCache
+{
+    /* The field is ready once its future is; until then the robots which want it wait for it, and only them. */
+    struct Entry
+    {
+        std::shared_future< std::shared_ptr< FlowField > > field;
+        std::size_t memory_usage;
+        uint64_t added;
+    };
+
+    const BitPlane& m_walls;
+    std::size_t m_memory_limit;
+    std::size_t m_memory_usage;
+
+    std::unordered_map< uint32_t, Entry > m_entries;
+
+    /* Moves on with every field put in, so that the fields used since the last one have the latest time. */
+    std::atomic< uint64_t > m_clock;
+
+    /* Moves on with every field dropped. */
+    std::atomic< unsigned > m_generation;
+
+    mutable std::mutex m_mutex;
+
+    void erase( const uint32_t goal );
+    void evict( const uint32_t kept_goal );
+
+    public:
+        /**
+         * @brief Creates an empty cache for the walls of a given plane,
+         *        which has to stay around for as long as the cache does.
+         */
+        explicit FlowFieldCache( const BitPlane& walls );
+
+        FlowFieldCache( const FlowFieldCache& ) = delete;
+        FlowFieldCache& operator =( const FlowFieldCache& ) = delete;
+
+        /**
+         * @return Number of bytes the fields may take up before the least
+         *         recently used ones are dropped; the most recently used
+         *         one is always kept.
+         */
+        std::size_t memory_limit() const;
+
+        /**
+         * @brief Sets the number of bytes the fields may take up.
+         */
+        void set_memory_limit( const std::size_t limit );
+
+        /**
+         * @return Number of bytes the fields currently take up.
+         */
+        std::size_t memory_usage() const;
+
+        /**
+         * @return Number of fields currently kept.
+         */
+        std::size_t size() const;
+
+        /**
+         * @return Number which changes whenever a field is dropped; as long
+         *         as it stays the same, a field got before is still kept.
+         */
+        unsigned generation() const
+        {
+            return m_generation.load( std::memory_order_acquire );
+        }
+
+        /**
+         * @return Flow field of a given goal, worked out now if it isn't
+         *         already kept, or null if there wasn't enough memory to;
+         *         safe to call from multiple threads at once.
+         */
+        std::shared_ptr< const FlowField > field( const unsigned goal_x, const unsigned goal_y );
+
+        /**
+         * @brief Lets the cache know that a field it handed out is still
+         *        being used, without taking its lock.
+         */
+        void mark_used( const FlowField& field ) const
+        {
+            const uint64_t now = m_clock.load( std::memory_order_relaxed );
+            if( field.m_last_use.load( std::memory_order_relaxed ) != now )
+                field.m_last_use.store( now, std::memory_order_relaxed );
+        }
+
+        /**
+         * @brief Works out again the part of every field which a change of
+         *        a given block of the plane affects; to be called after
+         *        every change.
+         */
+        void update( const unsigned x, const unsigned y );
+
+        /**
+         * @brief Drops every field.
+         */
+        void clear();
+};
+
+#endif // FLOWFIELDCACHE_H
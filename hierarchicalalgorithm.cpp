@@ -0,0 +1,165 @@
+#include "hierarchicalalgorithm.h"
+#include "routingalgorithmregistry.h"
+#include "clustergraph.h"
+#include "robot.h"
+#include "scene.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static const StaticAlgorithmRegistration registrar( "HPA*", [](){
+    return std::unique_ptr< RoutingAlgorithm >( new HierarchicalAlgorithm() );
+} );
+
+HierarchicalAlgorithm::HierarchicalAlgorithm() :
+    m_has_path( false ),
+    m_path_goal_x( 0 ),
+    m_path_goal_y( 0 ),
+    m_path_version( 0 ),
+    m_checked_version( 0 ),
+    m_is_searching( false ),
+    m_has_failed( false ),
+    m_failed_from( 0 ),
+    m_failed_goal_x( 0 ),
+    m_failed_goal_y( 0 ),
+    m_failed_version( 0 )
+{
+}
+
+HierarchicalAlgorithm::~HierarchicalAlgorithm()
+{
+}
+
+void HierarchicalAlgorithm::initialize( const Robot& robot )
+{
+    m_waypoints.clear();
+    m_path.clear();
+    m_has_path = false;
+    m_search.clear();
+    m_is_searching = false;
+    m_has_failed = false;
+}
+
+bool HierarchicalAlgorithm::plan( const Robot& robot, const ClusterGraph& graph )
+{
+    const uint32_t here = robot.y() * robot.scene().width() + robot.x();
+
+    /* Nothing can change until the robot moves or the walls do. */
+    if( m_has_failed && m_failed_from == here && m_failed_goal_x == robot.goal_x() && m_failed_goal_y == robot.goal_y() && m_failed_version == graph.version() )
+        return false;
+
+    std::size_t budget = planning_budget() - planning_spent();
+    const ClusterGraph::PathResult result = graph.find_path( robot.x(), robot.y(), robot.goal_x(), robot.goal_y(), budget, m_search, m_waypoints );
+    spend_planning_budget( planning_budget() - budget, result == ClusterGraph::PathResult::OutOfBudget );
+
+    m_is_searching = result == ClusterGraph::PathResult::OutOfBudget;
+    m_has_path = result == ClusterGraph::PathResult::Found;
+    m_path.clear();
+    if( m_is_searching )
+        return false;
+
+    m_path_goal_x = robot.goal_x();
+    m_path_goal_y = robot.goal_y();
+    m_path_version = graph.version();
+    m_checked_version = graph.version();
+
+    m_has_failed = !m_has_path;
+    m_failed_from = here;
+    m_failed_goal_x = robot.goal_x();
+    m_failed_goal_y = robot.goal_y();
+    m_failed_version = graph.version();
+
+    return m_has_path;
+}
+
+/* Fills in the blocks up to the next entrance. */
+bool HierarchicalAlgorithm::refine( const Robot& robot, const ClusterGraph& graph )
+{
+    const unsigned width = robot.scene().width();
+    const uint32_t next = m_waypoints.back();
+
+    return graph.find_local_path( robot.x(), robot.y(), next % width, next / width, m_path );
+}
+
+/*
+ * Every two consecutive waypoints are in the same cluster or in two next
+ * to each other, so the clusters of the waypoints, and the robot's own,
+ * are all the path goes through.
+ */
+bool HierarchicalAlgorithm::is_path_rebuilt( const Robot& robot, const ClusterGraph& graph ) const
+{
+    if( graph.cluster_version( graph.cluster_of( robot.x(), robot.y() ) ) > m_path_version )
+        return true;
+
+    const unsigned width = robot.scene().width();
+    for( const uint32_t waypoint: m_waypoints )
+    {
+        if( graph.cluster_version( graph.cluster_of( waypoint % width, waypoint / width ) ) > m_path_version )
+            return true;
+    }
+
+    return false;
+}
+
+float HierarchicalAlgorithm::run( const Robot& robot, const float elapsed )
+{
+    const ClusterGraph& graph = robot.scene().cluster_graph();
+    const unsigned width = robot.scene().width();
+    const uint32_t here = robot.y() * width + robot.x();
+
+    if( m_has_path && (m_path_goal_x != robot.goal_x() || m_path_goal_y != robot.goal_y()) )
+        m_has_path = false;
+
+    /* The walls changed somewhere; only the paths through there are planned again. */
+    if( m_has_path && m_checked_version != graph.version() )
+    {
+        m_checked_version = graph.version();
+        if( is_path_rebuilt( robot, graph ) )
+            m_has_path = false;
+    }
+
+    if( m_has_path )
+    {
+        while( !m_waypoints.empty() && m_waypoints.back() == here )
+        {
+            m_waypoints.pop_back();
+            m_path.clear();
+        }
+
+        while( !m_path.empty() && m_path.back() == here )
+            m_path.pop_back();
+
+        /* Pushed away from the path by someone else; the way to the next entrance is found again. */
+        if( !m_path.empty() )
+        {
+            const int next_x = m_path.back() % width;
+            const int next_y = m_path.back() / width;
+            if( std::abs( next_x - int( robot.x() ) ) > 1 || std::abs( next_y - int( robot.y() ) ) > 1 )
+                m_path.clear();
+        }
+    }
+    else
+        plan( robot, graph );
+
+    /* Pushed too far for the next entrance to be reached from this cluster. */
+    if( m_has_path && m_path.empty() && !m_waypoints.empty() && !refine( robot, graph ) && plan( robot, graph ) && !m_waypoints.empty() )
+        refine( robot, graph );
+
+    if( m_is_searching )
+        return NAN;
+
+    const float x = robot.x() + robot.frac_x();
+    const float y = robot.y() + robot.frac_y();
+
+    float target_x = robot.goal_x() + 0.5f;
+    float target_y = robot.goal_y() + 0.5f;
+
+    /* Without a path it's still better to head towards the goal than to stand still. */
+    if( m_has_path && !m_path.empty() )
+    {
+        target_x = m_path.back() % width + 0.5f;
+        target_y = m_path.back() / width + 0.5f;
+    }
+
+    return atan2f( target_y - y, target_x - x );
+}
@@ -0,0 +1,65 @@
+#ifndef HIERARCHICALALGORITHM_H
+#define HIERARCHICALALGORITHM_H
+
+#include "routingalgorithm.h"
+#include "clustergraph.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Follows a path to the goal found over the Scene's ClusterGraph,
+ *        which all of the robots share; the path goes from entrance to
+ *        entrance, and the blocks between them are only filled in for
+ *        the part the robot is about to walk.
+ *
+ * Unlike the other algorithms this one plans with the actual walls of
+ * the scene instead of what the robot has seen; other robots are
+ * ignored, since they move. The path is planned again whenever a
+ * cluster it has yet to go through is rebuilt, because its walls changed.
+ *
+ * A search over the entrances which goes through more of them than the
+ * planning budget allows is suspended, and carried on with in the
+ * following runs, while the robot waits where it is. The searches
+ * within a cluster, which are bounded by its size, aren't counted.
+ */
+class HierarchicalAlgorithm : public RoutingAlgorithm
+{
+    /* The entrances left to go through, as y * width + x; the goal first and the next one last. */
+    std::vector< uint32_t > m_waypoints;
+
+    /* The blocks up to the next entrance, in the same order. */
+    std::vector< uint32_t > m_path;
+
+    bool m_has_path;
+    unsigned m_path_goal_x;
+    unsigned m_path_goal_y;
+
+    /* Version of the graph the path was planned in, and the last one it was checked against. */
+    unsigned m_path_version;
+    unsigned m_checked_version;
+
+    /* The search which ran out of the budget, if any. */
+    ClusterGraph::PathSearch m_search;
+    bool m_is_searching;
+
+    /* Where planning last failed, so that it isn't retried every tick. */
+    bool m_has_failed;
+    uint32_t m_failed_from;
+    unsigned m_failed_goal_x;
+    unsigned m_failed_goal_y;
+    unsigned m_failed_version;
+
+    bool plan( const Robot& robot, const ClusterGraph& graph );
+    bool refine( const Robot& robot, const ClusterGraph& graph );
+    bool is_path_rebuilt( const Robot& robot, const ClusterGraph& graph ) const;
+
+    public:
+        explicit HierarchicalAlgorithm();
+        virtual ~HierarchicalAlgorithm();
+
+        virtual void initialize( const Robot& robot ) override;
+        virtual float run( const Robot& robot, const float elapsed ) override;
+};
+
+#endif // HIERARCHICALALGORITHM_H
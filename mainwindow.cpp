@@ -3,13 +3,15 @@
 #include "scenewidget.h"
 #include "routingalgorithmregistry.h"
 #include "simulation.h"
+#include "simulationthread.h"
 #include "scene.h"
-#include "robot.h"
-#include "routingalgorithm.h"
 
 #include <QButtonGroup>
 #include <QDir>
 
+/* Simulated seconds per real second for every entry of the speed combo box; zero means unlimited. */
+static const int speed_multipliers[] = { 1, 10, 100, 0 };
+
 static QString get_user_path()
 {
     QString qpath = QDir::homePath();
@@ -33,7 +35,7 @@ static QString get_user_path()
 MainWindow::MainWindow( QWidget *parent ) :
     QMainWindow( parent ),
     m_ui( new Ui::MainWindow ),
-    m_simulation( new Simulation( std::make_shared< Scene >( 32, 32 ) ) )
+    m_simulation_thread( new SimulationThread( std::unique_ptr< Simulation >( new Simulation( std::make_shared< Scene >( 32, 32 ) ) ) ) )
 {
     m_ui->setupUi( this );
 
@@ -47,10 +49,10 @@ MainWindow::MainWindow( QWidget *parent ) :
                       SIGNAL(buttonClicked(QAbstractButton*)),
                       SLOT(slot_scene_button_clicked(QAbstractButton*)) );
 
-    QObject::connect( &m_simulation_timer, SIGNAL(timeout()), SLOT(slot_update_simulation()) );
-    m_simulation_timer.setInterval( 10 );
-
-    m_scene_widget = new SceneWidget( m_simulation->scene() );
+    m_scene_widget = new SceneWidget();
+    m_scene_widget->set_command_handler( [this]( const SceneCommand& command ) {
+        return m_simulation_thread->post( command );
+    });
     m_ui->sceneScrollArea->setWidget( m_scene_widget );
 
     for( auto& pair: RoutingAlgorithmRegistry::instance().algorithm_map() )
@@ -60,10 +62,17 @@ MainWindow::MainWindow( QWidget *parent ) :
     }
 
     load( get_user_path() + "autosave.dat" );
+    m_simulation_thread->start();
+
+    /* Roughly matches the refresh rate of the screen. */
+    QObject::connect( &m_snapshot_timer, SIGNAL(timeout()), SLOT(slot_update_snapshot()) );
+    m_snapshot_timer.setInterval( 16 );
+    m_snapshot_timer.start();
 }
 
 MainWindow::~MainWindow()
 {
+    m_simulation_thread->stop();
     save( get_user_path() + "autosave.dat" );
     delete m_ui;
 }
@@ -74,7 +83,7 @@ bool MainWindow::load( const QString& filename )
     if( fp.open( QIODevice::ReadOnly ) )
     {
         QDataStream stream( &fp );
-        m_simulation->scene()->deserialize( stream );
+        m_simulation_thread->simulation().scene()->deserialize( stream );
 
         fp.close();
         return true;
@@ -89,7 +98,7 @@ bool MainWindow::save( const QString& filename ) const
     if( fp.open( QIODevice::WriteOnly ) )
     {
         QDataStream stream( &fp );
-        m_simulation->scene()->serialize( stream );
+        m_simulation_thread->simulation().scene()->serialize( stream );
 
         fp.close();
         return true;
@@ -98,14 +107,12 @@ bool MainWindow::save( const QString& filename ) const
     return false;
 }
 
-void MainWindow::slot_update_simulation()
+void MainWindow::slot_update_snapshot()
 {
-    float elapsed = double( m_simulation_timekeeper.nsecsElapsed() ) / double( 1000000000.0 );
-    m_simulation_timekeeper.restart();
-    m_simulation->run( elapsed );
+    if( !m_simulation_thread->update_snapshot() )
+        return;
 
-    /* TODO: Only dirty regions should be repainted. */
-    m_scene_widget->repaint();
+    m_scene_widget->set_snapshot( m_simulation_thread->snapshot() );
 }
 
 void MainWindow::on_action_Quit_triggered()
@@ -115,6 +122,7 @@ void MainWindow::on_action_Quit_triggered()
 
 void MainWindow::on_startSimulationButton_toggled( bool checked )
 {
+    SceneCommand command = { SceneCommand::Type::StopSimulation, 0, 0, false, 0, std::string() };
     if( checked )
     {
         auto& algorithm_map = RoutingAlgorithmRegistry::instance().algorithm_map();
@@ -123,29 +131,19 @@ void MainWindow::on_startSimulationButton_toggled( bool checked )
         assert( i != algorithm_map.end() );
         if( i != algorithm_map.end() )
         {
-            auto& factory_method = i->second;
-            for( Robot& robot: m_simulation->scene()->robot_list() )
-            {
-                /*
-                    if( robot.routing_algorithm() != nullptr )
-                        continue;
-                */
-
-                auto algorithm = factory_method();
-                assert( algorithm.get() != nullptr );
-
-                robot.set_routing_algorithm( std::move( algorithm ) );
-            }
+            command.type = SceneCommand::Type::StartSimulation;
+            command.algorithm = i->first;
         }
     }
 
+    m_simulation_thread->post( command );
     m_ui->startSimulationButton->setText( checked ? "Running..." : "Start" );
-    m_simulation_timekeeper.start();
+}
 
-    if( checked )
-        m_simulation_timer.start();
-    else
-        m_simulation_timer.stop();
+void MainWindow::on_speedComboBox_currentIndexChanged( int index )
+{
+    if( index >= 0 )
+        m_simulation_thread->set_speed_multiplier( speed_multipliers[ index ] );
 }
 
 void MainWindow::slot_scene_button_clicked( QAbstractButton * pressed_button )
@@ -3,7 +3,6 @@
 
 #include <QMainWindow>
 #include <QTimer>
-#include <QElapsedTimer>
 #include <memory>
 
 namespace Ui {
@@ -13,7 +12,7 @@ class MainWindow;
 class QButtonGroup;
 class QAbstractButton;
 
-class Simulation;
+class SimulationThread;
 class SceneWidget;
 
 class MainWindow : public QMainWindow
@@ -27,9 +26,10 @@ class MainWindow : public QMainWindow
     private slots:
         void on_action_Quit_triggered();
         void on_startSimulationButton_toggled( bool checked );
+        void on_speedComboBox_currentIndexChanged( int index );
 
         void slot_scene_button_clicked( QAbstractButton * button );
-        void slot_update_simulation();
+        void slot_update_snapshot();
 
     private:
 
@@ -39,10 +39,9 @@ class MainWindow : public QMainWindow
         Ui::MainWindow * m_ui;
         SceneWidget * m_scene_widget;
         QButtonGroup * m_scene_button_group;
-        QTimer m_simulation_timer;
-        QElapsedTimer m_simulation_timekeeper;
+        QTimer m_snapshot_timer;
 
-        std::unique_ptr< Simulation > m_simulation;
+        std::unique_ptr< SimulationThread > m_simulation_thread;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,127 @@
+#include "occupancypyramid.h"
+
+#include <algorithm>
+
+OccupancyPyramid::OccupancyPyramid( const unsigned width, const unsigned height ) :
+    m_width( width ),
+    m_height( height )
+{
+    unsigned level_width = std::max( (width + (1u << base_shift) - 1) >> base_shift, 1u );
+    unsigned level_height = std::max( (height + (1u << base_shift) - 1) >> base_shift, 1u );
+
+    for( ;; )
+    {
+        Level level;
+        level.width = level_width;
+        level.height = level_height;
+        level.counts.assign( std::size_t( level_width ) * level_height, 0 );
+        m_levels.push_back( std::move( level ) );
+
+        if( level_width == 1 && level_height == 1 )
+            break;
+
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
+    }
+}
+
+unsigned OccupancyPyramid::width() const
+{
+    return m_width;
+}
+
+unsigned OccupancyPyramid::height() const
+{
+    return m_height;
+}
+
+unsigned OccupancyPyramid::level_count() const
+{
+    return m_levels.size();
+}
+
+unsigned OccupancyPyramid::level_width( const unsigned level ) const
+{
+    return m_levels[ level ].width;
+}
+
+unsigned OccupancyPyramid::level_height( const unsigned level ) const
+{
+    return m_levels[ level ].height;
+}
+
+unsigned OccupancyPyramid::total() const
+{
+    return m_levels.back().counts[ 0 ];
+}
+
+void OccupancyPyramid::increment( const unsigned x, const unsigned y )
+{
+    assert( x < m_width && y < m_height );
+
+    for( unsigned level = 0; level < m_levels.size(); ++level )
+    {
+        Level& data = m_levels[ level ];
+        data.counts[ (y >> (base_shift + level)) * data.width + (x >> (base_shift + level)) ]++;
+    }
+}
+
+void OccupancyPyramid::decrement( const unsigned x, const unsigned y )
+{
+    assert( x < m_width && y < m_height );
+
+    for( unsigned level = 0; level < m_levels.size(); ++level )
+    {
+        Level& data = m_levels[ level ];
+        uint32_t& count = data.counts[ (y >> (base_shift + level)) * data.width + (x >> (base_shift + level)) ];
+
+        assert( count > 0 );
+        count--;
+    }
+}
+
+/*
+ * Recalculates every level above the first one from the one below it,
+ * where every area is made of up to 2x2 areas.
+ */
+void OccupancyPyramid::sum_levels()
+{
+    for( unsigned level = 1; level < m_levels.size(); ++level )
+    {
+        const Level& below = m_levels[ level - 1 ];
+        Level& data = m_levels[ level ];
+
+        std::fill( data.counts.begin(), data.counts.end(), 0 );
+        for( unsigned y = 0; y < below.height; ++y )
+        {
+            for( unsigned x = 0; x < below.width; ++x )
+                data.counts[ (y / 2) * data.width + x / 2 ] += below.counts[ y * below.width + x ];
+        }
+    }
+}
+
+bool OccupancyPyramid::is_area_empty( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    if( x >= m_width || y >= m_height || width == 0 || height == 0 )
+        return true;
+
+    const unsigned last_x = std::min( x + width, m_width ) - 1;
+    const unsigned last_y = std::min( y + height, m_height ) - 1;
+
+    /* The first level whose areas are at least as big as the rectangle, which then touches at most 2x2 of them. */
+    unsigned level = 0;
+    while( level + 1 < m_levels.size() && area_size( level ) < std::max( width, height ) )
+        level++;
+
+    const unsigned shift = base_shift + level;
+    for( unsigned area_y = y >> shift; area_y <= last_y >> shift; ++area_y )
+    {
+        for( unsigned area_x = x >> shift; area_x <= last_x >> shift; ++area_x )
+        {
+            if( count( level, area_x, area_y ) != 0 )
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,135 @@
+#ifndef OCCUPANCYPYRAMID_H
+#define OCCUPANCYPYRAMID_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+/**
+ * @brief Counts of the occupied blocks of a map, summed up over square
+ *        areas of 8x8, 16x16, 32x32 and so on blocks, up to an area
+ *        which covers the whole map.
+ *
+ * Kept up to date one block at a time, it answers questions like
+ * "is there anything at all in this 64x64 area?" by looking at a few
+ * counts instead of every single block, and gives a downscaled view
+ * of the map for drawing it from far away.
+ */
+class OccupancyPyramid
+{
+    public:
+        /* The finest level sums up areas of 8x8 blocks. */
+        static const unsigned base_shift = 3;
+
+    private:
+        struct Level
+        {
+            unsigned width;
+            unsigned height;
+            std::vector< uint32_t > counts;
+        };
+
+        unsigned m_width;
+        unsigned m_height;
+        std::vector< Level > m_levels;
+
+        void sum_levels();
+
+    public:
+        explicit OccupancyPyramid( const unsigned width, const unsigned height );
+
+        /**
+         * @return Width of the map, in blocks.
+         */
+        unsigned width() const;
+
+        /**
+         * @return Height of the map, in blocks.
+         */
+        unsigned height() const;
+
+        /**
+         * @return Number of levels; the last one is a single area
+         *         covering the whole map.
+         */
+        unsigned level_count() const;
+
+        /**
+         * @return Width of a given level, in its own areas.
+         */
+        unsigned level_width( const unsigned level ) const;
+
+        /**
+         * @return Height of a given level, in its own areas.
+         */
+        unsigned level_height( const unsigned level ) const;
+
+        /**
+         * @return Width and height of the areas of a given level, in blocks.
+         */
+        static unsigned area_size( const unsigned level )
+        {
+            return 1u << (base_shift + level);
+        }
+
+        /**
+         * @return Number of occupied blocks in a given area of a given level.
+         */
+        unsigned count( const unsigned level, const unsigned x, const unsigned y ) const
+        {
+            const Level& data = m_levels[ level ];
+            assert( x < data.width && y < data.height );
+
+            return data.counts[ y * data.width + x ];
+        }
+
+        /**
+         * @return Number of occupied blocks in the whole map.
+         */
+        unsigned total() const;
+
+        /**
+         * @brief Marks a block, which wasn't occupied before, as occupied.
+         */
+        void increment( const unsigned x, const unsigned y );
+
+        /**
+         * @brief Marks a block, which was occupied before, as not occupied.
+         */
+        void decrement( const unsigned x, const unsigned y );
+
+        /**
+         * @brief Recounts everything from scratch.
+         * @param is_occupied Called as is_occupied( x, y ) for every block of the map.
+         */
+        template < typename is_occupied_t >
+        void build( is_occupied_t is_occupied )
+        {
+            Level& base = m_levels[ 0 ];
+            std::fill( base.counts.begin(), base.counts.end(), 0 );
+
+            for( unsigned y = 0; y < m_height; ++y )
+            {
+                uint32_t * counts = &base.counts[ (y >> base_shift) * base.width ];
+                for( unsigned x = 0; x < m_width; ++x )
+                {
+                    if( is_occupied( x, y ) )
+                        counts[ x >> base_shift ]++;
+                }
+            }
+
+            sum_levels();
+        }
+
+        /**
+         * @return Whenever no block in a given rectangle is occupied; the parts
+         *         outside of the map are ignored. Only whole areas are looked
+         *         at, so an empty rectangle right next to an occupied block
+         *         may not be recognized as such, but an occupied one
+         *         is never reported as empty.
+         */
+        bool is_area_empty( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const;
+};
+
+#endif // OCCUPANCYPYRAMID_H
@@ -0,0 +1,123 @@
+#include "rendersnapshot.h"
+#include "robot.h"
+
+#include <algorithm>
+
+RenderSnapshot::RenderSnapshot() :
+    width( 0 ),
+    height( 0 ),
+    full_update( false ),
+    obstacle_map( 0, 0 ),
+    has_selected_robot( false ),
+    selected_robot_id( 0 ),
+    selected_obstacle_map( 0, 0 )
+{
+}
+
+void RenderSnapshot::capture( Scene& scene, const Robot * selected_robot, const bool keep_changes )
+{
+    if( !keep_changes )
+    {
+        full_update = false;
+        changed_blocks.clear();
+    }
+
+    static thread_local std::vector< std::pair< unsigned, unsigned > > dirty_blocks;
+    bool all_blocks_dirty = scene.take_dirty_blocks( dirty_blocks );
+
+    /* Past a certain point sending the whole map is cheaper. */
+    const std::size_t max_changed_blocks = std::max( std::size_t( 4096 ), std::size_t( scene.width() ) * scene.height() / 16 );
+    if( changed_blocks.size() + dirty_blocks.size() > max_changed_blocks )
+        all_blocks_dirty = true;
+
+    if( scene.width() != width || scene.height() != height )
+        all_blocks_dirty = true;
+
+    width = scene.width();
+    height = scene.height();
+
+    if( full_update || all_blocks_dirty )
+    {
+        full_update = true;
+        obstacle_map = scene.obstacle_map();
+        changed_blocks.clear();
+    }
+    else
+    {
+        for( BlockChange& change: changed_blocks )
+            change.type = scene.at( change.x, change.y );
+
+        for( const auto& block: dirty_blocks )
+        {
+            const BlockChange change = { block.first, block.second, scene.at( block.first, block.second ) };
+            changed_blocks.push_back( change );
+        }
+    }
+
+    const RobotStates& states = scene.robot_states();
+    robots.resize( states.size() );
+    for( std::size_t i = 0; i < states.size(); ++i )
+    {
+        RobotSnapshot& robot = robots[ i ];
+        robot.id = states.id[ i ];
+        robot.x = states.x[ i ];
+        robot.y = states.y[ i ];
+        robot.frac_x = states.frac_x[ i ];
+        robot.frac_y = states.frac_y[ i ];
+        robot.has_goal = states.robot[ i ]->has_goal();
+        robot.goal_x = states.goal_x[ i ];
+        robot.goal_y = states.goal_y[ i ];
+    }
+
+    robot_grid.build( width, height, robots.size(), [this]( const std::size_t index, unsigned& o_x, unsigned& o_y ) {
+        o_x = robots[ index ].x;
+        o_y = robots[ index ].y;
+        return true;
+    });
+
+    goal_grid.build( width, height, robots.size(), [this]( const std::size_t index, unsigned& o_x, unsigned& o_y ) {
+        o_x = robots[ index ].goal_x;
+        o_y = robots[ index ].goal_y;
+        return robots[ index ].has_goal && o_x < width && o_y < height;
+    });
+
+    has_selected_robot = selected_robot != nullptr;
+    if( selected_robot )
+    {
+        /* Cheap, since the tiles themselves are shared until the robot changes them. */
+        selected_robot_id = selected_robot->id();
+        selected_obstacle_map = selected_robot->obstacle_map();
+        selected_visibility_map = selected_robot->visibility_map();
+    }
+    else if( selected_obstacle_map.width() != 0 )
+        selected_obstacle_map = TiledArray2d< ObstacleType >( 0, 0 );
+
+    /* Only the tiles the robot has written to can have any robots in them. */
+    remembered_robots.clear();
+    const unsigned tile_size = TiledArray2d< ObstacleType >::tile_size;
+    for( unsigned tile_y = 0; tile_y < selected_obstacle_map.height(); tile_y += tile_size )
+    {
+        for( unsigned tile_x = 0; tile_x < selected_obstacle_map.width(); tile_x += tile_size )
+        {
+            if( selected_obstacle_map.is_untouched_tile( tile_x, tile_y ) )
+                continue;
+
+            const unsigned max_x = std::min( tile_x + tile_size, selected_obstacle_map.width() );
+            const unsigned max_y = std::min( tile_y + tile_size, selected_obstacle_map.height() );
+            for( unsigned y = tile_y; y < max_y; ++y )
+            {
+                for( unsigned x = tile_x; x < max_x; ++x )
+                {
+                    if( selected_obstacle_map.at( x, y ) == ObstacleType::Robot )
+                        remembered_robots.push_back( std::make_pair( x, y ) );
+                }
+            }
+        }
+    }
+
+    remembered_robot_grid.build( width, height, remembered_robots.size(), [this]( const std::size_t index, unsigned& o_x, unsigned& o_y ) {
+        o_x = remembered_robots[ index ].first;
+        o_y = remembered_robots[ index ].second;
+        return o_x < width && o_y < height;
+    });
+}
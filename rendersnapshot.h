@@ -0,0 +1,86 @@
+#ifndef RENDERSNAPSHOT_H
+#define RENDERSNAPSHOT_H
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include "array2d.h"
+#include "tiledarray2d.h"
+#include "visibilitywindow.h"
+#include "bucketgrid.h"
+#include "scene.h"
+
+class Robot;
+
+/**
+ * @brief A robot as seen by the renderer.
+ */
+struct RobotSnapshot
+{
+    unsigned id;
+    unsigned x, y;
+    float frac_x, frac_y;
+    bool has_goal;
+    unsigned goal_x, goal_y;
+};
+
+/**
+ * @brief A block whose obstacle has changed.
+ */
+struct BlockChange
+{
+    unsigned x, y;
+    ObstacleType type;
+};
+
+/**
+ * @brief Everything needed to draw a Scene, copied out of it so that
+ *        it can be painted while the simulation keeps on running.
+ *
+ * To keep snapshots small the obstacle map is only sent whole when it
+ * has to be; otherwise only the blocks changed since the previous
+ * snapshot are, and the reader is expected to keep its own copy.
+ */
+struct RenderSnapshot
+{
+    unsigned width;
+    unsigned height;
+
+    /* Every robot, in the order of Scene::robot_states(). */
+    std::vector< RobotSnapshot > robots;
+
+    /* Indices into robots, by where the robots and their goals are. */
+    BucketGrid robot_grid;
+    BucketGrid goal_grid;
+
+    /* Whenever obstacle_map is valid and replaces the reader's copy. */
+    bool full_update;
+    Array2d< ObstacleType > obstacle_map;
+
+    /* Blocks changed since the previous snapshot; empty on a full update. */
+    std::vector< BlockChange > changed_blocks;
+
+    /* What the selected robot, if any, knows about and can see. */
+    bool has_selected_robot;
+    unsigned selected_robot_id;
+    TiledArray2d< ObstacleType > selected_obstacle_map;
+    VisibilityWindow selected_visibility_map;
+
+    /* The blocks where the selected robot remembers a robot, indexed by where they are. */
+    std::vector< std::pair< unsigned, unsigned > > remembered_robots;
+    BucketGrid remembered_robot_grid;
+
+    explicit RenderSnapshot();
+
+    /**
+     * @brief Fills the snapshot with the current state of @a scene,
+     *        taking the scene's dirty blocks.
+     * @param keep_changes Whenever the changes already in the snapshot
+     *        should be kept, because they never reached the reader;
+     *        they are sent again with the blocks' current obstacles.
+     */
+    void capture( Scene& scene, const Robot * selected_robot, const bool keep_changes );
+};
+
+#endif // RENDERSNAPSHOT_H
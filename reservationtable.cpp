@@ -0,0 +1,92 @@
+#include "reservationtable.h"
+
+ReservationTable::ReservationTable() :
+    m_slots( horizon ),
+    m_now( 0 ),
+    m_time( 0.0 )
+{
+}
+
+uint32_t ReservationTable::now() const
+{
+    return m_now;
+}
+
+bool ReservationTable::is_within_horizon( const uint32_t slot ) const
+{
+    return slot >= m_now && slot - m_now < horizon;
+}
+
+void ReservationTable::advance( const double slots )
+{
+    m_time += slots;
+
+    const uint32_t slot = uint32_t( m_time );
+    if( slot <= m_now )
+        return;
+
+    /* A slot which has passed is reused as the one which has just come within the horizon. */
+    if( slot - m_now >= horizon )
+        clear();
+    else
+    {
+        for( uint32_t passed = m_now; passed < slot; ++passed )
+            m_slots[ passed % horizon ].clear();
+    }
+
+    m_now = slot;
+}
+
+uint32_t ReservationTable::owner( const uint32_t block, const uint32_t slot ) const
+{
+    if( !is_within_horizon( slot ) )
+        return no_owner;
+
+    const std::unordered_map< uint32_t, uint32_t >& blocks = m_slots[ slot % horizon ];
+    auto found = blocks.find( block );
+    return found == blocks.end() ? no_owner : found->second;
+}
+
+bool ReservationTable::reserve( const uint32_t block, const uint32_t slot, const uint32_t owner )
+{
+    if( !is_within_horizon( slot ) )
+        return false;
+
+    auto inserted = m_slots[ slot % horizon ].insert( std::make_pair( block, owner ) );
+    return inserted.second || inserted.first->second == owner;
+}
+
+bool ReservationTable::take( const uint32_t block, const uint32_t slot, const uint32_t owner )
+{
+    if( !is_within_horizon( slot ) )
+        return false;
+
+    m_slots[ slot % horizon ][ block ] = owner;
+    return true;
+}
+
+void ReservationTable::release( const uint32_t block, const uint32_t slot, const uint32_t owner )
+{
+    if( !is_within_horizon( slot ) )
+        return;
+
+    std::unordered_map< uint32_t, uint32_t >& blocks = m_slots[ slot % horizon ];
+    auto found = blocks.find( block );
+    if( found != blocks.end() && found->second == owner )
+        blocks.erase( found );
+}
+
+std::size_t ReservationTable::size() const
+{
+    std::size_t count = 0;
+    for( const auto& blocks: m_slots )
+        count += blocks.size();
+
+    return count;
+}
+
+void ReservationTable::clear()
+{
+    for( auto& blocks: m_slots )
+        blocks.clear();
+}
@@ -0,0 +1,97 @@
+#ifndef RESERVATIONTABLE_H
+#define RESERVATIONTABLE_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * @brief Which robot is going to be in which block at which point in
+ *        time, so that robots can plan around each other instead of
+ *        running into each other.
+ *
+ * Time is counted in slots, each as long as it takes a robot to cross
+ * a block; the simulation moves it forward as it goes. Only the next
+ * few slots can be reserved; the table is a ring of them, each a hash
+ * of the reserved blocks, and as time goes on the slots which have
+ * passed are emptied, one at a time, to be reused.
+ *
+ * Unlike the rest of the scene the table is written to by the routing
+ * algorithms, so the ones using it have to report that they aren't
+ * safe to run in parallel; see RoutingAlgorithm::is_parallel_safe().
+ */
+class ReservationTable
+{
+    public:
+        /* Number of slots, starting with the current one, which can be reserved. */
+        static const unsigned horizon = 64;
+
+        /* Owner of the blocks nobody has reserved. */
+        static const uint32_t no_owner = 0xffffffff;
+
+    private:
+        /* Owner of every reserved block of every slot, by block index. */
+        std::vector< std::unordered_map< uint32_t, uint32_t > > m_slots;
+        uint32_t m_now;
+
+        /* Time since the start, in slots; kept here so that every simulation of the scene shares it. */
+        double m_time;
+
+        bool is_within_horizon( const uint32_t slot ) const;
+
+    public:
+        explicit ReservationTable();
+
+        /**
+         * @return The current slot.
+         */
+        uint32_t now() const;
+
+        /**
+         * @brief Moves the time forward by a given number of slots, which
+         *        needn't be whole, emptying every slot which has passed.
+         */
+        void advance( const double slots );
+
+        /**
+         * @return Owner of a given block in a given slot, or no_owner if
+         *         it isn't reserved; slots which have already passed or
+         *         are beyond the horizon are never reserved.
+         */
+        uint32_t owner( const uint32_t block, const uint32_t slot ) const;
+
+        /**
+         * @brief Reserves a given block in a given slot.
+         * @return Whenever the block is now reserved by @a owner; fails
+         *         if somebody else reserved it first, or if the slot has
+         *         already passed or is beyond the horizon.
+         */
+        bool reserve( const uint32_t block, const uint32_t slot, const uint32_t owner );
+
+        /**
+         * @brief Reserves a given block in a given slot even if somebody
+         *        else already has; for when there's nowhere else to be.
+         * @return Whenever the block is now reserved by @a owner; fails
+         *         only if the slot has already passed or is beyond the
+         *         horizon.
+         */
+        bool take( const uint32_t block, const uint32_t slot, const uint32_t owner );
+
+        /**
+         * @brief Drops a reservation made by @a owner; does nothing if
+         *        the block is reserved by somebody else, or not at all.
+         */
+        void release( const uint32_t block, const uint32_t slot, const uint32_t owner );
+
+        /**
+         * @return Number of reservations in every slot together.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief Drops every reservation; the time stays where it is.
+         */
+        void clear();
+};
+
+#endif // RESERVATIONTABLE_H
@@ -0,0 +1,22 @@
+# Microbenchmarks; build with `qmake robosim-bench.pro && make -f Makefile.robosim-bench`.
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+TARGET = robosim-bench
+TEMPLATE = app
+
+MAKEFILE = Makefile.robosim-bench
+OBJECTS_DIR = .obj/robosim-bench
+
+include(robosim-core.pri)
+
+SOURCES += benchmain.cpp \
+    scenewidget.cpp
+
+HEADERS += scenewidget.h
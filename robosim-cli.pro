@@ -0,0 +1,17 @@
+# Headless simulation runner; build with `qmake robosim-cli.pro && make -f Makefile.robosim-cli`.
+
+QT       = core
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -std=c++11
+
+TARGET = robosim-cli
+TEMPLATE = app
+
+MAKEFILE = Makefile.robosim-cli
+OBJECTS_DIR = .obj/robosim-cli
+
+include(robosim-core.pri)
+
+SOURCES += climain.cpp
@@ -0,0 +1,52 @@
+# Simulation core shared by every target; depends only on QtCore.
+
+INCLUDEPATH += $$PWD
+CONFIG += thread
+
+SOURCES += $$PWD/scene.cpp \
+    $$PWD/routingalgorithm.cpp \
+    $$PWD/dummyalgorithm.cpp \
+    $$PWD/astaralgorithm.cpp \
+    $$PWD/dstarlitealgorithm.cpp \
+    $$PWD/hierarchicalalgorithm.cpp \
+    $$PWD/flowfieldalgorithm.cpp \
+    $$PWD/cooperativealgorithm.cpp \
+    $$PWD/routingalgorithmregistry.cpp \
+    $$PWD/simulation.cpp \
+    $$PWD/robot.cpp \
+    $$PWD/visibilitywindow.cpp \
+    $$PWD/bitplane.cpp \
+    $$PWD/occupancypyramid.cpp \
+    $$PWD/clustergraph.cpp \
+    $$PWD/flowfieldcache.cpp \
+    $$PWD/reservationtable.cpp \
+    $$PWD/threadpool.cpp \
+    $$PWD/rendersnapshot.cpp \
+    $$PWD/simulationthread.cpp
+
+HEADERS += $$PWD/scene.h \
+    $$PWD/routingalgorithm.h \
+    $$PWD/dummyalgorithm.h \
+    $$PWD/astaralgorithm.h \
+    $$PWD/dstarlitealgorithm.h \
+    $$PWD/hierarchicalalgorithm.h \
+    $$PWD/flowfieldalgorithm.h \
+    $$PWD/cooperativealgorithm.h \
+    $$PWD/routingalgorithmregistry.h \
+    $$PWD/simulation.h \
+    $$PWD/specializedsimulation.h \
+    $$PWD/array2d.h \
+    $$PWD/tiledarray2d.h \
+    $$PWD/bucketgrid.h \
+    $$PWD/robot.h \
+    $$PWD/visibilitywindow.h \
+    $$PWD/bitplane.h \
+    $$PWD/occupancypyramid.h \
+    $$PWD/clustergraph.h \
+    $$PWD/flowfieldcache.h \
+    $$PWD/reservationtable.h \
+    $$PWD/threadpool.h \
+    $$PWD/spscqueue.h \
+    $$PWD/triplebuffer.h \
+    $$PWD/rendersnapshot.h \
+    $$PWD/simulationthread.h
@@ -8,25 +8,13 @@ QMAKE_CXXFLAGS += -std=c++11
 TARGET = robosim
 TEMPLATE = app
 
+include(robosim-core.pri)
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    scenewidget.cpp \
-    scene.cpp \
-    routingalgorithm.cpp \
-    dummyalgorithm.cpp \
-    routingalgorithmregistry.cpp \
-    simulation.cpp \
-    robot.cpp
+    scenewidget.cpp
 
 HEADERS  += mainwindow.h \
-    scenewidget.h \
-    scene.h \
-    routingalgorithm.h \
-    dummyalgorithm.h \
-    routingalgorithmregistry.h \
-    simulation.h \
-    array2d.h \
-    robot.h
+    scenewidget.h
 
 FORMS    += mainwindow.ui
@@ -2,61 +2,74 @@
 #include "scene.h"
 #include "routingalgorithm.h"
 
-Robot::Robot( const unsigned id, const unsigned x, const unsigned y, Scene& scene ) :
+Robot::Robot( const std::size_t index, Scene& scene ) :
     m_scene( scene ),
-    m_visibility_map( scene.width(), scene.height(), false ),
+    m_index( index ),
     m_obstacle_map( scene.width(), scene.height() ),
-    m_id( id ),
-    m_x( x ), m_y( y ),
-    m_goal_x( x ), m_goal_y( y ),
-    m_frac_x( 0.5f ), m_frac_y( 0.5f )
+    m_has_lost_knowledge_changes( false )
 {
-    assert( x < m_obstacle_map.width() );
-    assert( y < m_obstacle_map.height() );
+    assert( index < scene.robot_states().size() );
+    assert( x() < m_obstacle_map.width() );
+    assert( y() < m_obstacle_map.height() );
 }
 
 Robot::~Robot()
 {
 }
 
+void Robot::update_active()
+{
+    m_scene.m_robot_states.active[ m_index ] = has_goal() && m_routing_algorithm;
+}
+
+std::size_t Robot::index() const
+{
+    return m_index;
+}
+
+const Scene& Robot::scene() const
+{
+    return m_scene;
+}
+
 unsigned Robot::id() const
 {
-    return m_id;
+    return m_scene.m_robot_states.id[ m_index ];
 }
 
 unsigned Robot::x() const
 {
-    return m_x;
+    return m_scene.m_robot_states.x[ m_index ];
 }
 
 unsigned Robot::y() const
 {
-    return m_y;
+    return m_scene.m_robot_states.y[ m_index ];
 }
 
 float Robot::frac_x() const
 {
-    return m_frac_x;
+    return m_scene.m_robot_states.frac_x[ m_index ];
 }
 
 float Robot::frac_y() const
 {
-    return m_frac_y;
+    return m_scene.m_robot_states.frac_y[ m_index ];
 }
 
 unsigned Robot::goal_x() const
 {
-    return m_goal_x;
+    return m_scene.m_robot_states.goal_x[ m_index ];
 }
 
 unsigned Robot::goal_y() const
 {
-    return m_goal_y;
+    return m_scene.m_robot_states.goal_y[ m_index ];
 }
 
 bool Robot::has_goal() const
 {
-    return m_goal_x < m_scene.width() && m_goal_y < m_scene.height();
+    return goal_x() < m_scene.width() && goal_y() < m_scene.height();
 }
 
 void Robot::set_goal( const unsigned x, const unsigned y )
@@ -64,14 +77,16 @@ void Robot::set_goal( const unsigned x, const unsigned y )
     assert( x < m_obstacle_map.width() );
     assert( y < m_obstacle_map.height() );
 
-    m_goal_x = x;
-    m_goal_y = y;
+    m_scene.m_robot_states.goal_x[ m_index ] = x;
+    m_scene.m_robot_states.goal_y[ m_index ] = y;
+    update_active();
 }
 
 void Robot::clear_goal()
 {
-    m_goal_x = -1;
-    m_goal_y = -1;
+    m_scene.m_robot_states.goal_x[ m_index ] = -1;
+    m_scene.m_robot_states.goal_y[ m_index ] = -1;
+    update_active();
 }
 
 RoutingAlgorithm * Robot::routing_algorithm()
@@ -87,25 +102,68 @@ const RoutingAlgorithm * Robot::routing_algorithm() const
 void Robot::set_routing_algorithm( std::unique_ptr< RoutingAlgorithm > algorithm )
 {
     m_routing_algorithm = std::move( algorithm );
+    m_scene.m_robot_states.algorithm[ m_index ] = m_routing_algorithm.get();
+    m_scene.m_robot_states.algorithm_version++;
+    update_active();
+
     if( m_routing_algorithm )
         m_routing_algorithm->initialize( *this );
 }
 
-Array2d< bool >& Robot::visibility_map()
+VisibilityWindow& Robot::visibility_map()
 {
     return m_visibility_map;
 }
 
-Array2d< ObstacleType >& Robot::obstacle_map()
+const VisibilityWindow& Robot::visibility_map() const
+{
+    return m_visibility_map;
+}
+
+TiledArray2d< ObstacleType >& Robot::obstacle_map()
 {
     return m_obstacle_map;
 }
 
-const Array2d< ObstacleType >& Robot::obstacle_map() const
+const TiledArray2d< ObstacleType >& Robot::obstacle_map() const
 {
     return m_obstacle_map;
 }
 
+void Robot::remember( const unsigned x, const unsigned y, const ObstacleType type )
+{
+    /* Past this point it's cheaper for whoever looks at the changes to start from scratch. */
+    const std::size_t max_knowledge_changes = 1024;
+
+    if( !m_obstacle_map.set( x, y, type ) || m_has_lost_knowledge_changes )
+        return;
+
+    if( m_knowledge_changes.size() >= max_knowledge_changes )
+    {
+        std::vector< std::pair< unsigned, unsigned > >().swap( m_knowledge_changes );
+        m_has_lost_knowledge_changes = true;
+        return;
+    }
+
+    m_knowledge_changes.push_back( std::make_pair( x, y ) );
+}
+
+const std::vector< std::pair< unsigned, unsigned > >& Robot::knowledge_changes() const
+{
+    return m_knowledge_changes;
+}
+
+bool Robot::has_lost_knowledge_changes() const
+{
+    return m_has_lost_knowledge_changes;
+}
+
+void Robot::clear_knowledge_changes()
+{
+    m_knowledge_changes.clear();
+    m_has_lost_knowledge_changes = false;
+}
+
 void Robot::calculate_visibility()
 {
     m_scene.calculate_visibility_for( *this );
@@ -113,25 +171,30 @@ void Robot::calculate_visibility()
 
 bool Robot::can_see( const unsigned x, const unsigned y ) const
 {
-    if( x >= m_visibility_map.width() || y >= m_visibility_map.height() )
-        return false;
-
-    return m_visibility_map.at( x, y );
+    return m_visibility_map.is_visible( x, y );
 }
 
 bool Robot::move_to( const unsigned x, const unsigned y )
 {
-    if( x == m_x && y == m_y )
+    unsigned& current_x = m_scene.m_robot_states.x[ m_index ];
+    unsigned& current_y = m_scene.m_robot_states.y[ m_index ];
+
+    if( x == current_x && y == current_y )
         return true;
 
     if( m_scene.is_blocked( x, y ) )
         return false;
 
-    m_scene.m_obstacle_map.at( m_x, m_y ) = ObstacleType::None;
-    m_scene.m_obstacle_map.at( x, y ) = ObstacleType::Robot;
+    m_scene.set_obstacle( current_x, current_y, ObstacleType::None );
+    m_scene.set_obstacle( x, y, ObstacleType::Robot );
+    m_scene.m_robot_map.at( current_x, current_y ) = nullptr;
+    m_scene.m_robot_map.at( x, y ) = this;
+
+    m_scene.mark_changed( current_x, current_y );
+    m_scene.mark_changed( x, y );
 
-    m_x = x;
-    m_y = y;
+    current_x = x;
+    current_y = y;
 
     return true;
 }
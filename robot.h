@@ -2,34 +2,57 @@
 #define ROBOT_H
 
 #include "array2d.h"
+#include "tiledarray2d.h"
 #include "scene.h"
+#include "visibilitywindow.h"
 #include <memory>
+#include <vector>
+#include <utility>
 
 class RoutingAlgorithm;
 class Scene;
 class Simulation;
 
+/**
+ * @brief A handle to a robot inside of a Scene. The state which
+ *        is updated every simulation tick lives in the scene's
+ *        RobotStates; only the rarely touched data is kept here.
+ */
 class Robot
 {
+    friend class Scene;
     friend class Simulation;
 
     Scene& m_scene;
+    std::size_t m_index;
 
-    Array2d< bool > m_visibility_map;
-    Array2d< ObstacleType > m_obstacle_map;
+    VisibilityWindow m_visibility_map;
+    TiledArray2d< ObstacleType > m_obstacle_map;
+
+    /* Blocks of m_obstacle_map changed by remember() since clear_knowledge_changes(). */
+    std::vector< std::pair< unsigned, unsigned > > m_knowledge_changes;
+    bool m_has_lost_knowledge_changes;
 
     std::unique_ptr< RoutingAlgorithm > m_routing_algorithm;
 
-    unsigned m_id;
-    unsigned m_x, m_y;
-    unsigned m_goal_x, m_goal_y;
-    float m_frac_x, m_frac_y;
+    void update_active();
 
     public:
 
-        explicit Robot( const unsigned id, const unsigned x, const unsigned y, Scene& scene );
+        explicit Robot( const std::size_t index, Scene& scene );
         ~Robot();
 
+        /**
+         * @return Index of the robot's state in Scene::robot_states().
+         */
+        std::size_t index() const;
+
+        /**
+         * @return The scene the robot is in; the routing algorithms which
+         *         plan with its actual walls use it, like HierarchicalAlgorithm.
+         */
+        const Scene& scene() const;
+
         /**
          * @return The ID of the robot.
          */
@@ -96,21 +119,54 @@ class Robot
         void set_routing_algorithm( std::unique_ptr< RoutingAlgorithm > algorithm );
 
         /**
-         * @return A visibility map updated every simulation tick.
-         *         If a tile is visible by the robot it has 'true'
-         *         set at its position; 'false' otherwise.
+         * @return A visibility map, centered on the robot, updated
+         *         whenever anything in the robot's view changes.
+         */
+        VisibilityWindow& visibility_map();
+
+        /**
+         * @return A visibility map, centered on the robot, updated
+         *         whenever anything in the robot's view changes.
+         */
+        const VisibilityWindow& visibility_map() const;
+
+        /**
+         * @return Obstacle map, as memorized by the robot; blocks
+         *         the robot has never seen are ObstacleType::None.
+         */
+        TiledArray2d< ObstacleType >& obstacle_map();
+
+        /**
+         * @return Obstacle map, as memorized by the robot; blocks
+         *         the robot has never seen are ObstacleType::None.
+         */
+        const TiledArray2d< ObstacleType >& obstacle_map() const;
+
+        /**
+         * @brief Sets what the robot knows about a given block,
+         *        keeping track of the change, if there is one.
+         */
+        void remember( const unsigned x, const unsigned y, const ObstacleType type );
+
+        /**
+         * @return Blocks whose value in obstacle_map() was changed by
+         *         remember() since the last clear_knowledge_changes();
+         *         a block may be listed more than once.
          */
-        Array2d< bool >& visibility_map();
+        const std::vector< std::pair< unsigned, unsigned > >& knowledge_changes() const;
 
         /**
-         * @return Obstacle map, as memorized by the robot.
+         * @return Whenever more blocks have changed than could be kept
+         *         track of, in which case knowledge_changes() is empty
+         *         and anything in obstacle_map() might have changed.
          */
-        Array2d< ObstacleType >& obstacle_map();
+        bool has_lost_knowledge_changes() const;
 
         /**
-         * @return Obstacle map, as memorized by the robot.
+         * @brief Forgets about the changes made to obstacle_map() so far;
+         *        the simulation does this after running the routing algorithm.
          */
-        const Array2d< ObstacleType >& obstacle_map() const;
+        void clear_knowledge_changes();
 
         /**
          * @brief Recalculates the robot's visibility.
@@ -1,9 +1,73 @@
 #include "routingalgorithm.h"
 
-RoutingAlgorithm::RoutingAlgorithm()
+const std::size_t RoutingAlgorithm::unlimited_budget;
+
+RoutingAlgorithm::RoutingAlgorithm() :
+    m_planning_budget( unlimited_budget ),
+    m_planning_spent( 0 ),
+    m_is_out_of_budget( false )
 {
 }
 
 RoutingAlgorithm::~RoutingAlgorithm()
 {
 }
+
+bool RoutingAlgorithm::is_parallel_safe() const
+{
+    return true;
+}
+
+std::size_t RoutingAlgorithm::planning_budget() const
+{
+    return m_planning_budget;
+}
+
+void RoutingAlgorithm::set_planning_budget( const std::size_t budget )
+{
+    m_planning_budget = budget;
+    m_planning_spent = 0;
+    m_is_out_of_budget = false;
+}
+
+std::size_t RoutingAlgorithm::planning_spent() const
+{
+    return m_planning_spent;
+}
+
+bool RoutingAlgorithm::is_out_of_budget() const
+{
+    return m_is_out_of_budget;
+}
+
+void RoutingAlgorithm::spend_planning_budget( const std::size_t spent, const bool is_out_of_budget )
+{
+    m_planning_spent = spent;
+    m_is_out_of_budget = is_out_of_budget;
+}
+
+void RoutingAlgorithm::run_batch( const RoutingBatch& batch, const float elapsed )
+{
+    for( std::size_t i = 0; i < batch.size; ++i )
+    {
+        batch.algorithm[ i ]->set_planning_budget( batch.planning_budget );
+        batch.angle[ i ] = batch.algorithm[ i ]->run( *batch.robot[ i ], elapsed );
+    }
+}
+
+RoutingBatch RoutingBatch::slice( const std::size_t begin, const std::size_t end ) const
+{
+    RoutingBatch batch = *this;
+    batch.size = end - begin;
+    batch.robot += begin;
+    batch.algorithm += begin;
+    batch.x += begin;
+    batch.y += begin;
+    batch.frac_x += begin;
+    batch.frac_y += begin;
+    batch.goal_x += begin;
+    batch.goal_y += begin;
+    batch.angle += begin;
+
+    return batch;
+}
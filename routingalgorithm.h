@@ -1,7 +1,39 @@
 #ifndef ROUTINGALGORITHM_H
 #define ROUTINGALGORITHM_H
 
+#include <cstddef>
+
 class Robot;
+class RoutingAlgorithm;
+
+/**
+ * @brief Robots whose routing algorithms are all of the same type, with
+ *        the state their steering needs laid out side by side.
+ */
+struct RoutingBatch
+{
+    std::size_t size;
+
+    const Robot * const * robot;
+    RoutingAlgorithm * const * algorithm;
+    const unsigned * x;
+    const unsigned * y;
+    const float * frac_x;
+    const float * frac_y;
+    const unsigned * goal_x;
+    const unsigned * goal_y;
+
+    /* Where the picked angles go, one for every robot. */
+    float * angle;
+
+    /* Planning budget of every robot in the batch; see RoutingAlgorithm::planning_budget(). */
+    std::size_t planning_budget;
+
+    /**
+     * @return The robots from @a begin up to @a end.
+     */
+    RoutingBatch slice( const std::size_t begin, const std::size_t end ) const;
+};
 
 /**
  * @brief Base class for every routing algorithm. A new
@@ -15,10 +47,53 @@ class RoutingAlgorithm
     RoutingAlgorithm& operator =( const RoutingAlgorithm& ) = delete;
     void operator =( RoutingAlgorithm&& ) = delete;
 
+    std::size_t m_planning_budget;
+    std::size_t m_planning_spent;
+    bool m_is_out_of_budget;
+
+    protected:
+        /**
+         * @brief Records how much of the planning budget run() has used,
+         *        and whenever it has run out of it.
+         */
+        void spend_planning_budget( const std::size_t spent, const bool is_out_of_budget );
+
     public:
+        /* A planning budget which never runs out. */
+        static const std::size_t unlimited_budget = std::size_t( -1 );
+
         explicit RoutingAlgorithm();
         virtual ~RoutingAlgorithm();
 
+        /**
+         * @return Most nodes a search may go through or look at in a single
+         *         run(), unlimited_budget by default; the simulation sets it.
+         *
+         * An algorithm whose search runs out keeps what it has done so
+         * far and carries on with it in the next run(), picking some
+         * interim direction, or NaN, in the meantime, so that no single
+         * robot can hold up a tick for long.
+         */
+        std::size_t planning_budget() const;
+
+        /**
+         * @brief Sets the planning budget of every following run().
+         */
+        void set_planning_budget( const std::size_t budget );
+
+        /**
+         * @return How much of the planning budget the last run() used;
+         *         zero for the algorithms which don't search.
+         */
+        std::size_t planning_spent() const;
+
+        /**
+         * @return Whenever the last run() ran out of the planning budget
+         *         with a search it could carry on with right away, so that
+         *         whatever the other robots didn't use is best given to it.
+         */
+        bool is_out_of_budget() const;
+
         /**
          * @brief Initializes the algorithm for a given robot.
          *        Called before starting the simulation.
@@ -29,9 +104,42 @@ class RoutingAlgorithm
          * @brief Runs the pathfinding algorithm.
          * @param elapsed Time elapsed since the last call.
          *
-         * @return Angle in radians.
+         * The algorithms of different robots are run concurrently,
+         * so this must not modify anything besides the algorithm
+         * itself; the scene is not modified while this runs,
+         * so Scene::cluster_graph() can be used to find long
+         * paths through the actual walls, and the summaries
+         * of those, like Scene::wall_pyramid(), to quickly
+         * rule out whole areas.
+         *
+         * Robot::knowledge_changes() lists what the robot has
+         * learned since the previous call, so that a plan can
+         * be repaired instead of made again from scratch.
+         *
+         * @return Angle in radians; NaN to stay in place.
          */
         virtual float run( const Robot& robot, const float elapsed ) = 0;
+
+        /**
+         * @brief Runs the pathfinding algorithm of every robot in a batch,
+         *        all of which are of the same type as this one; called on
+         *        the first one's algorithm.
+         *
+         * Everything said about run() holds for this too. The default
+         * calls run() of every robot's own algorithm, with the batch's
+         * planning budget; the algorithms which can steer many robots
+         * at once should override it.
+         */
+        virtual void run_batch( const RoutingBatch& batch, const float elapsed );
+
+        /**
+         * @return Whenever run() can run concurrently with the other
+         *         robots' algorithms. The ones which can't, like those
+         *         reserving blocks in Scene::reservation_table(), are run
+         *         one at a time once the others are done, in the order
+         *         of Scene::robot_states(); the default is true.
+         */
+        virtual bool is_parallel_safe() const;
 };
 
 #endif // ROUTINGALGORITHM_H
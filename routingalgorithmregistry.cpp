@@ -1,5 +1,6 @@
 #include "routingalgorithmregistry.h"
 #include "routingalgorithm.h"
+#include "simulation.h"
 
 RoutingAlgorithmRegistry::RoutingAlgorithmRegistry()
 {
@@ -32,3 +33,21 @@ std::unique_ptr< RoutingAlgorithm > RoutingAlgorithmRegistry::instantiate_algori
 
     return std::unique_ptr< RoutingAlgorithm >( i->second() );
 }
+
+void RoutingAlgorithmRegistry::register_simulation(
+        const std::string& name,
+        const SimulationFactoryWrapper& factory_method )
+{
+    m_simulation_map.insert( std::make_pair( name, factory_method ) );
+}
+
+std::unique_ptr< Simulation > RoutingAlgorithmRegistry::instantiate_simulation(
+        const std::string& name,
+        const std::shared_ptr< Scene >& scene ) const
+{
+    auto i = m_simulation_map.find( name );
+    if( i == m_simulation_map.end() )
+        return std::unique_ptr< Simulation >( new Simulation( scene ) );
+
+    return i->second( scene );
+}
@@ -7,6 +7,8 @@
 #include <map>
 
 class RoutingAlgorithm;
+class Simulation;
+class Scene;
 
 class RoutingAlgorithmRegistry
 {
@@ -20,10 +22,15 @@ class RoutingAlgorithmRegistry
         typedef std::function< std::remove_pointer< FactoryMethodType >::type > FactoryMethodWrapper;
         typedef std::map< std::string, FactoryMethodWrapper > FactoryMethodMap;
 
+        typedef std::function< std::unique_ptr< Simulation > ( const std::shared_ptr< Scene >& ) > SimulationFactoryWrapper;
+
     private:
 
         FactoryMethodMap m_algorithm_map;
 
+        /* Simulations specialized for a fleet using nothing but one algorithm, by the algorithm's name. */
+        std::map< std::string, SimulationFactoryWrapper > m_simulation_map;
+
     public:
 
         explicit RoutingAlgorithmRegistry();
@@ -32,6 +39,16 @@ class RoutingAlgorithmRegistry
         const FactoryMethodMap& algorithm_map() const;
         std::unique_ptr< RoutingAlgorithm > instantiate_algorithm( const std::string& name ) const;
 
+        void register_simulation( const std::string& name, const SimulationFactoryWrapper& factory_method );
+
+        /**
+         * @return A simulation of a scene whose robots all use the algorithm
+         *         called @a name; one specialized for it, if it has one,
+         *         or else a plain Simulation. A specialized one still works
+         *         if other algorithms turn up, only as fast as a plain one.
+         */
+        std::unique_ptr< Simulation > instantiate_simulation( const std::string& name, const std::shared_ptr< Scene >& scene ) const;
+
         static RoutingAlgorithmRegistry& instance();
 };
 
@@ -43,6 +60,14 @@ class StaticAlgorithmRegistration
         {
             RoutingAlgorithmRegistry::instance().register_algorithm( name, factory_method );
         }
+
+        StaticAlgorithmRegistration( const std::string& name,
+                                     const RoutingAlgorithmRegistry::FactoryMethodWrapper& factory_method,
+                                     const RoutingAlgorithmRegistry::SimulationFactoryWrapper& simulation_factory_method )
+        {
+            RoutingAlgorithmRegistry::instance().register_algorithm( name, factory_method );
+            RoutingAlgorithmRegistry::instance().register_simulation( name, simulation_factory_method );
+        }
 };
 
 #endif // ROUTINGALGORITHMREGISTRY_H
@@ -1,14 +1,88 @@
 #include "scene.h"
 #include "robot.h"
 #include "routingalgorithm.h"
+#include "visibilitywindow.h"
+#include "threadpool.h"
 
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <functional>
+#include <algorithm>
+
+RobotStates::RobotStates() :
+    algorithm_version( 0 )
+{
+}
+
+std::size_t RobotStates::size() const
+{
+    return id.size();
+}
+
+void RobotStates::push_back( const unsigned robot_id, const unsigned robot_x, const unsigned robot_y )
+{
+    id.push_back( robot_id );
+    x.push_back( robot_x );
+    y.push_back( robot_y );
+    goal_x.push_back( robot_x );
+    goal_y.push_back( robot_y );
+    frac_x.push_back( 0.5f );
+    frac_y.push_back( 0.5f );
+    active.push_back( false );
+    visibility_dirty.push_back( false );
+    algorithm.push_back( nullptr );
+    robot.push_back( nullptr );
+    algorithm_version++;
+}
+
+void RobotStates::erase( const std::size_t index )
+{
+    assert( index < size() );
+
+    id.erase( id.begin() + index );
+    x.erase( x.begin() + index );
+    y.erase( y.begin() + index );
+    goal_x.erase( goal_x.begin() + index );
+    goal_y.erase( goal_y.begin() + index );
+    frac_x.erase( frac_x.begin() + index );
+    frac_y.erase( frac_y.begin() + index );
+    active.erase( active.begin() + index );
+    visibility_dirty.erase( visibility_dirty.begin() + index );
+    algorithm.erase( algorithm.begin() + index );
+    robot.erase( robot.begin() + index );
+    algorithm_version++;
+}
+
+void RobotStates::clear()
+{
+    id.clear();
+    x.clear();
+    y.clear();
+    goal_x.clear();
+    goal_y.clear();
+    frac_x.clear();
+    frac_y.clear();
+    active.clear();
+    visibility_dirty.clear();
+    algorithm.clear();
+    robot.clear();
+    algorithm_version++;
+}
 
 Scene::Scene( const unsigned width, const unsigned height ) :
     m_obstacle_map( width, height ),
-    m_last_robot_id( 0 )
+    m_robot_map( width, height, nullptr ),
+    m_wall_plane( width, height ),
+    m_robot_plane( width, height ),
+    m_wall_pyramid( width, height ),
+    m_built_cluster_graph( nullptr ),
+    m_flow_fields( m_wall_plane ),
+    m_last_robot_id( 0 ),
+    m_view_distance( 4 ),
+    m_visibility_algorithm( VisibilityAlgorithm::Shadowcasting ),
+    m_visibility_invalidated( false ),
+    m_all_blocks_dirty( true )
 {
 }
 
@@ -36,6 +110,16 @@ const std::list< Robot >& Scene::robot_list() const
     return m_robot_list;
 }
 
+RobotStates& Scene::robot_states()
+{
+    return m_robot_states;
+}
+
+const RobotStates& Scene::robot_states() const
+{
+    return m_robot_states;
+}
+
 void Scene::add_wall( const unsigned x, const unsigned y )
 {
     set_wall( x, y, true );
@@ -48,32 +132,95 @@ void Scene::remove_wall( const unsigned x, const unsigned y )
 
 void Scene::set_wall( const unsigned x, const unsigned y, const bool block )
 {
-    auto& cell = m_obstacle_map.at( x, y );
+    const ObstacleType cell = m_obstacle_map.at( x, y );
 
     if( block )
     {
         if( cell == ObstacleType::None )
-            cell = ObstacleType::Wall;
+        {
+            set_obstacle( x, y, ObstacleType::Wall );
+            mark_changed( x, y );
+        }
     }
     else
     {
         if( cell == ObstacleType::Wall )
-            cell = ObstacleType::None;
+        {
+            set_obstacle( x, y, ObstacleType::None );
+            mark_changed( x, y );
+        }
     }
 }
 
+void Scene::set_obstacle( const unsigned x, const unsigned y, const ObstacleType type )
+{
+    m_obstacle_map.at( x, y ) = type;
+
+    /* The bit planes still hold what was there before, even while deserializing. */
+    const bool is_wall = type == ObstacleType::Wall;
+    if( m_wall_plane.get( x, y ) != is_wall )
+    {
+        m_wall_plane.set( x, y, is_wall );
+        if( is_wall )
+            m_wall_pyramid.increment( x, y );
+        else
+            m_wall_pyramid.decrement( x, y );
+
+        if( m_cluster_graph )
+            m_cluster_graph->update( x, y );
+
+        m_flow_fields.update( x, y );
+    }
+
+    m_robot_plane.set( x, y, type == ObstacleType::Robot );
+
+    if( m_all_blocks_dirty )
+        return;
+
+    /*
+     * Nobody might be taking the blocks out, so past a certain
+     * point it's better to simply give up on tracking them.
+     */
+    const std::size_t max_dirty_blocks = std::max( std::size_t( 4096 ), std::size_t( width() ) * height() / 16 );
+    if( m_dirty_blocks.size() >= max_dirty_blocks )
+    {
+        m_dirty_blocks.clear();
+        m_all_blocks_dirty = true;
+        return;
+    }
+
+    m_dirty_blocks.push_back( std::make_pair( x, y ) );
+}
+
+bool Scene::take_dirty_blocks( std::vector< std::pair< unsigned, unsigned > >& o_blocks )
+{
+    o_blocks.clear();
+
+    const bool all_blocks_dirty = m_all_blocks_dirty;
+    m_all_blocks_dirty = false;
+
+    std::swap( o_blocks, m_dirty_blocks );
+    return all_blocks_dirty;
+}
+
 Robot& Scene::add_robot( const unsigned x, const unsigned y )
 {
-    ObstacleType obstacle_type = at( x, y );
+    Robot * existing_robot = m_robot_map.at( x, y );
+
+    if( existing_robot != nullptr )
+        erase_robot( *existing_robot );
 
-    if( obstacle_type == ObstacleType::Robot )
-        m_robot_list.remove_if( [x, y]( const Robot& robot ) { return robot.x() == x && robot.y() == y; } );
+    m_robot_states.push_back( m_last_robot_id, x, y );
+    m_robot_list.emplace_back( m_robot_states.size() - 1, *this );
 
-    m_obstacle_map.at( x, y ) = ObstacleType::Robot;
-    m_robot_list.emplace_back( m_last_robot_id, x, y, *this );
+    Robot& robot = m_robot_list.back();
+    m_robot_states.robot.back() = &robot;
+    set_obstacle( x, y, ObstacleType::Robot );
+    m_robot_map.at( x, y ) = &robot;
     m_last_robot_id++;
+    mark_changed( x, y );
 
-    return m_robot_list.back();
+    return robot;
 }
 
 Robot * Scene::get_robot( const unsigned x, const unsigned y )
@@ -83,26 +230,18 @@ Robot * Scene::get_robot( const unsigned x, const unsigned y )
 
 const Robot * Scene::get_robot( const unsigned x, const unsigned y ) const
 {
-    if( x > width() || y > height() )
+    if( x >= width() || y >= height() )
         return nullptr;
 
-    ObstacleType obstacle_type = at( x, y );
-
-    if( obstacle_type != ObstacleType::Robot )
-        return nullptr; /* There is no robot there. */
-
-    for( const Robot& robot: m_robot_list )
-    {
-        if( robot.x() == x && robot.y() == y )
-            return &robot;
-    }
+    const Robot * robot = m_robot_map.at( x, y );
 
     /*
-     * This shouldn't happen; if a robot exists in the obstacle map
-     * then it should also exist in the list.
+     * The robot map should always mirror the obstacle map; if a robot
+     * exists in one of them then it should also exist in the other.
      */
-    assert( false );
-    return nullptr;
+    assert( (robot != nullptr) == (at( x, y ) == ObstacleType::Robot) );
+
+    return robot;
 }
 
 void Scene::remove_robot( Robot& robot )
@@ -112,13 +251,32 @@ void Scene::remove_robot( Robot& robot )
     if( obstacle_type != ObstacleType::Robot )
         return;
 
-    m_obstacle_map.at( robot.x(), robot.y() ) = ObstacleType::None;
-    m_robot_list.remove_if( [&robot]( const Robot& i ) { return &i == &robot; } );
+    erase_robot( robot );
 
     if( m_robot_list.empty() )
         m_last_robot_id = 0;
 }
 
+void Scene::erase_robot( Robot& robot )
+{
+    const std::size_t index = robot.index();
+
+    set_obstacle( robot.x(), robot.y(), ObstacleType::None );
+    m_robot_map.at( robot.x(), robot.y() ) = nullptr;
+    mark_changed( robot.x(), robot.y() );
+
+    /* Both containers are kept in the same order. */
+    auto i = m_robot_list.begin();
+    std::advance( i, index );
+    assert( &*i == &robot );
+
+    m_robot_list.erase( i );
+    m_robot_states.erase( index );
+
+    for( std::size_t j = index; j < m_robot_states.size(); ++j )
+        m_robot_states.robot[ j ]->m_index = j;
+}
+
 ObstacleType Scene::at( const unsigned x, const unsigned y ) const
 {
     return m_obstacle_map.at( x, y );
@@ -137,27 +295,308 @@ bool Scene::is_blocked( const unsigned x, const unsigned y ) const
     return m_obstacle_map.at( x, y ) != ObstacleType::None;
 }
 
-void Scene::calculate_visibility_for( Robot& robot ) const
+const BitPlane& Scene::wall_plane() const
 {
-    /* Maximum view distance. */
-    const int view_distance = 4;
+    return m_wall_plane;
+}
 
-    Array2d< bool >& visibility_map = robot.visibility_map();
+const BitPlane& Scene::robot_plane() const
+{
+    return m_robot_plane;
+}
 
-    /* Mark everything as invisible. */
-    visibility_map.clear_with( false );
+const OccupancyPyramid& Scene::wall_pyramid() const
+{
+    return m_wall_pyramid;
+}
+
+const ClusterGraph& Scene::cluster_graph() const
+{
+    const ClusterGraph * graph = m_built_cluster_graph.load( std::memory_order_acquire );
+    if( graph != nullptr )
+        return *graph;
+
+    std::lock_guard< std::mutex > lock( m_cluster_graph_mutex );
+    if( !m_cluster_graph )
+    {
+        m_cluster_graph.reset( new ClusterGraph( m_wall_plane, m_wall_pyramid ) );
+        m_built_cluster_graph.store( m_cluster_graph.get(), std::memory_order_release );
+    }
+
+    return *m_cluster_graph;
+}
+
+FlowFieldCache& Scene::flow_field_cache() const
+{
+    return m_flow_fields;
+}
+
+ReservationTable& Scene::reservation_table() const
+{
+    return m_reservations;
+}
+
+bool Scene::is_area_free( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    if( x >= this->width() || y >= this->height() || width > this->width() - x || height > this->height() - y )
+        return false;
+
+    return !m_wall_plane.any( x, y, width, height ) && !m_robot_plane.any( x, y, width, height );
+}
+
+unsigned Scene::count_obstacles( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    if( x >= this->width() || y >= this->height() )
+        return 0;
+
+    const unsigned clipped_width = std::min( width, this->width() - x );
+    const unsigned clipped_height = std::min( height, this->height() - y );
+
+    return m_wall_plane.count( x, y, clipped_width, clipped_height ) +
+           m_robot_plane.count( x, y, clipped_width, clipped_height );
+}
+
+bool Scene::has_line_of_sight( unsigned x0, unsigned y0, unsigned x1, unsigned y1 ) const
+{
+    assert( x0 < width() && y0 < height() );
+    assert( x1 < width() && y1 < height() );
+
+    if( y0 > y1 )
+    {
+        std::swap( x0, x1 );
+        std::swap( y0, y1 );
+    }
+
+    /* Returns whenever any block in a given span of a row, except for the end points, is occupied. */
+    auto is_span_blocked = [this, x0, y0, x1, y1]( const unsigned y, const unsigned x_begin, const unsigned x_end ) {
+        unsigned excluded[ 2 ];
+        unsigned excluded_count = 0;
+
+        if( y == y0 && x0 >= x_begin && x0 <= x_end )
+            excluded[ excluded_count++ ] = x0;
+
+        if( y == y1 && x1 >= x_begin && x1 <= x_end && !(excluded_count == 1 && excluded[ 0 ] == x1) )
+            excluded[ excluded_count++ ] = x1;
+
+        if( excluded_count == 2 && excluded[ 0 ] > excluded[ 1 ] )
+            std::swap( excluded[ 0 ], excluded[ 1 ] );
+
+        auto is_blocked = [this, y]( const unsigned begin, const unsigned end ) {
+            return m_wall_plane.any_in_row( y, begin, end ) || m_robot_plane.any_in_row( y, begin, end );
+        };
+
+        unsigned begin = x_begin;
+        for( unsigned i = 0; i < excluded_count; ++i )
+        {
+            if( excluded[ i ] > begin && is_blocked( begin, excluded[ i ] - 1 ) )
+                return true;
+
+            begin = excluded[ i ] + 1;
+        }
+
+        return begin <= x_end && is_blocked( begin, x_end );
+    };
+
+    if( y0 == y1 )
+        return !is_span_blocked( y0, std::min( x0, x1 ), std::max( x0, x1 ) );
+
+    /*
+     * Walk the line one row at a time, in coordinates doubled so that the
+     * block centers are integers, and test the whole span of blocks the
+     * line crosses in each row at once. Touching a corner counts as crossing.
+     */
+    const long long cx0 = 2 * (long long)x0 + 1;
+    const long long cy0 = 2 * (long long)y0 + 1;
+    const long long dx = 2 * ((long long)x1 - (long long)x0);
+    const long long dy = 2 * ((long long)y1 - (long long)y0);
+
+    for( unsigned y = y0; y <= y1; ++y )
+    {
+        const long long row_begin = std::max( 2 * (long long)y, cy0 );
+        const long long row_end = std::min( 2 * (long long)y + 2, cy0 + dy );
 
-    int rx = (int)robot.x();
-    int ry = (int)robot.y();
+        /* The line's doubled x coordinate at both edges of the row, scaled by dy. */
+        const long long a = cx0 * dy + (row_begin - cy0) * dx;
+        const long long b = cx0 * dy + (row_end - cy0) * dx;
 
-    int minx = rx;
-    int maxx = rx;
-    int miny = ry;
-    int maxy = ry;
+        /* Subtracting one also takes in the block to the left of a corner the line goes through. */
+        const unsigned x_begin = (unsigned)((std::min( a, b ) - 1) / (2 * dy));
+        const unsigned x_end = std::min( (unsigned)(std::max( a, b ) / (2 * dy)), width() - 1 );
 
-    visibility_map.at( rx, ry ) = true;
+        if( is_span_blocked( y, x_begin, x_end ) )
+            return false;
+    }
+
+    return true;
+}
+
+unsigned Scene::view_distance() const
+{
+    return m_view_distance;
+}
+
+void Scene::set_view_distance( const unsigned distance )
+{
+    if( distance == m_view_distance )
+        return;
+
+    m_view_distance = distance;
+    invalidate_visibility();
+}
+
+VisibilityAlgorithm Scene::visibility_algorithm() const
+{
+    return m_visibility_algorithm;
+}
+
+void Scene::set_visibility_algorithm( const VisibilityAlgorithm algorithm )
+{
+    if( algorithm == m_visibility_algorithm )
+        return;
+
+    m_visibility_algorithm = algorithm;
+    invalidate_visibility();
+}
+
+void Scene::mark_changed( const unsigned x, const unsigned y )
+{
+    if( !m_visibility_invalidated )
+        m_changed_cells.push_back( std::make_pair( x, y ) );
+}
+
+void Scene::invalidate_visibility()
+{
+    m_visibility_invalidated = true;
+    m_changed_cells.clear();
+}
+
+void Scene::update_visibility( ThreadPool * thread_pool )
+{
+    /*
+     * Every robot only writes to its own maps, so the robots can be
+     * split between threads; a chunk is a handful of robots, since
+     * the cost of one differs a lot with how open its surroundings are.
+     */
+    const std::size_t chunk = 16;
+
+    auto for_each_index = [&]( const std::size_t count, const std::function< void (std::size_t) >& function ) {
+        auto range = [&]( const std::size_t begin, const std::size_t end ) {
+            for( std::size_t i = begin; i < end; ++i )
+                function( i );
+        };
+
+        if( thread_pool )
+            thread_pool->parallel_for( count, chunk, range );
+        else
+            range( 0, count );
+    };
+
+    if( m_visibility_invalidated )
+    {
+        for_each_index( m_robot_states.size(), [this]( const std::size_t index ) {
+            calculate_visibility_for( *m_robot_states.robot[ index ] );
+        });
+
+        m_visibility_invalidated = false;
+        return;
+    }
+
+    /*
+     * A robot can only see blocks within the view distance of itself,
+     * so only the robots around a changed block need to be updated.
+     * A robot which has moved is covered too, since its own block
+     * has changed.
+     */
+    for( const auto& cell: m_changed_cells )
+    {
+        const unsigned min_x = cell.first >= m_view_distance ? cell.first - m_view_distance : 0;
+        const unsigned min_y = cell.second >= m_view_distance ? cell.second - m_view_distance : 0;
+        const unsigned max_x = std::min( cell.first + m_view_distance, width() - 1 );
+        const unsigned max_y = std::min( cell.second + m_view_distance, height() - 1 );
+
+        for( unsigned y = min_y; y <= max_y; ++y )
+        {
+            for( unsigned x = min_x; x <= max_x; ++x )
+            {
+                const Robot * robot = m_robot_map.at( x, y );
+                if( robot == nullptr || m_robot_states.visibility_dirty[ robot->index() ] )
+                    continue;
+
+                m_robot_states.visibility_dirty[ robot->index() ] = true;
+                m_visibility_queue.push_back( robot->index() );
+            }
+        }
+    }
+
+    for_each_index( m_visibility_queue.size(), [this]( const std::size_t i ) {
+        const std::size_t index = m_visibility_queue[ i ];
+        m_robot_states.visibility_dirty[ index ] = false;
+        calculate_visibility_for( *m_robot_states.robot[ index ] );
+    });
+
+    m_visibility_queue.clear();
+    m_changed_cells.clear();
+}
+
+/*
+ * Helpers for the symmetric shadowcasting; slopes are kept
+ * as fractions so that no floating point math is needed.
+ */
+namespace
+{
+    struct Slope
+    {
+        int numerator;
+        int denominator; /* Always positive. */
+    };
+
+    struct ShadowcastingRow
+    {
+        int depth;
+        Slope start;
+        Slope end;
+    };
+
+    int floor_div( const int a, const int b )
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    /* Rounds depth * slope to the nearest integer, rounding ties up. */
+    int round_ties_up( const int depth, const Slope& slope )
+    {
+        return floor_div( 2 * depth * slope.numerator + slope.denominator, 2 * slope.denominator );
+    }
+
+    /* Rounds depth * slope to the nearest integer, rounding ties down. */
+    int round_ties_down( const int depth, const Slope& slope )
+    {
+        return -floor_div( slope.denominator - 2 * depth * slope.numerator, 2 * slope.denominator );
+    }
+
+    /* The slope of the line going through the block's starting edge. */
+    Slope edge_slope( const int depth, const int column )
+    {
+        Slope slope = { 2 * column - 1, 2 * depth };
+        return slope;
+    }
+
+    /*
+     * A block is only lit when its center lies within the row's sector;
+     * this is what makes the field of view symmetric.
+     */
+    bool is_symmetric( const ShadowcastingRow& row, const int column )
+    {
+        return column * row.start.denominator >= row.depth * row.start.numerator &&
+               column * row.end.denominator <= row.depth * row.end.numerator;
+    }
+}
+
+void Scene::cast_rays( const unsigned origin_x, const unsigned origin_y, VisibilityWindow& visibility_map ) const
+{
+    const int rx = (int)origin_x;
+    const int ry = (int)origin_y;
 
-    /* TODO: Implement something more efficient? */
     for( float angle = 0.0f; angle < M_PI * 2.0f; angle += (M_PI * 2.0f / 48.0f) )
     {
         const float vx = cosf( angle );
@@ -170,7 +609,7 @@ void Scene::calculate_visibility_for( Robot& robot ) const
         float x = rx + 0.5f;
         float y = ry + 0.5f;
 
-        while( d < view_distance )
+        while( d < m_view_distance )
         {
             const int block_x = (int)truncf(x);
             const int block_y = (int)truncf(y);
@@ -179,12 +618,7 @@ void Scene::calculate_visibility_for( Robot& robot ) const
                 block_y < 0 || block_y >= (int)m_obstacle_map.height() )
                 break;
 
-            visibility_map.at( block_x, block_y ) = true;
-
-            minx = std::min(block_x, minx);
-            miny = std::min(block_y, miny);
-            maxx = std::max(block_x, maxx);
-            maxy = std::max(block_y, maxy);
+            visibility_map.set_visible( block_x, block_y );
 
             if( !(block_x == rx && block_y == ry) && (m_obstacle_map.at( x, y ) != ObstacleType::None) )
                 break;
@@ -199,26 +633,112 @@ void Scene::calculate_visibility_for( Robot& robot ) const
             d += fabsf( m );
         }
     }
+}
 
-    /* Update robot's view of the world. */
-    auto& obstacle_map = robot.obstacle_map();
-    for( int y = miny; y <= maxy; ++y )
-    {
-        if( y < 0 || y >= (int)visibility_map.height() )
-            continue;
+void Scene::cast_shadows( const unsigned origin_x, const unsigned origin_y, VisibilityWindow& visibility_map ) const
+{
+    const int radius = (int)m_view_distance;
+
+    /* Roughly matches the blocks a ray of length 'radius' would touch. */
+    const int radius_squared = radius * radius + radius;
 
-        for( int x = minx; x <= maxx; ++x )
+    /* Kept around per thread, so that nothing is allocated per robot. */
+    static thread_local std::vector< ShadowcastingRow > rows;
+    rows.clear();
+
+    /* Scan each of the four cardinal quadrants, row by row. */
+    for( int quadrant = 0; quadrant < 4; ++quadrant )
+    {
+        auto transform = [quadrant, origin_x, origin_y]( const int depth, const int column, int& o_x, int& o_y ) {
+            switch( quadrant )
+            {
+                case 0:  o_x = (int)origin_x + column; o_y = (int)origin_y - depth; break;
+                case 1:  o_x = (int)origin_x + depth;  o_y = (int)origin_y + column; break;
+                case 2:  o_x = (int)origin_x + column; o_y = (int)origin_y + depth; break;
+                default: o_x = (int)origin_x - depth;  o_y = (int)origin_y + column; break;
+            }
+        };
+
+        const ShadowcastingRow first_row = { 1, { -1, 1 }, { 1, 1 } };
+        rows.push_back( first_row );
+
+        while( !rows.empty() )
         {
-            if( x < 0 || x >= (int)visibility_map.width() )
-                continue;
+            ShadowcastingRow row = rows.back();
+            rows.pop_back();
 
-            if( visibility_map.at( x, y ) == false )
+            if( row.depth > radius )
                 continue;
 
-            obstacle_map.at( x, y ) = m_obstacle_map.at( x, y );
+            const int min_column = round_ties_up( row.depth, row.start );
+            const int max_column = round_ties_down( row.depth, row.end );
+
+            /* -1 - no previous block, 0 - floor, 1 - wall */
+            int previous = -1;
+            for( int column = min_column; column <= max_column; ++column )
+            {
+                int x, y;
+                transform( row.depth, column, x, y );
+
+                const bool in_bounds = x >= 0 && y >= 0 && x < (int)width() && y < (int)height();
+                const bool is_wall = !in_bounds || m_obstacle_map.at( x, y ) != ObstacleType::None;
+                const bool in_range = column * column + row.depth * row.depth <= radius_squared;
+
+                if( in_bounds && in_range && (is_wall || is_symmetric( row, column )) )
+                    visibility_map.set_visible( x, y );
+
+                if( previous == 1 && !is_wall )
+                    row.start = edge_slope( row.depth, column );
+
+                if( previous == 0 && is_wall )
+                {
+                    const ShadowcastingRow next_row = { row.depth + 1, row.start, edge_slope( row.depth, column ) };
+                    rows.push_back( next_row );
+                }
+
+                previous = is_wall ? 1 : 0;
+            }
+
+            if( previous == 0 )
+            {
+                const ShadowcastingRow next_row = { row.depth + 1, row.start, row.end };
+                rows.push_back( next_row );
+            }
         }
     }
+}
+
+void Scene::calculate_visibility_for( Robot& robot ) const
+{
+    const unsigned rx = robot.x();
+    const unsigned ry = robot.y();
+
+    /* Mark everything as invisible. */
+    VisibilityWindow& visibility_map = robot.visibility_map();
+    visibility_map.reset( rx, ry, m_view_distance );
+    visibility_map.set_visible( rx, ry );
+
+    if( m_visibility_algorithm == VisibilityAlgorithm::RayMarching )
+        cast_rays( rx, ry, visibility_map );
+    else
+        cast_shadows( rx, ry, visibility_map );
+
+    /* Update robot's view of the world. */
+    const unsigned min_x = rx >= m_view_distance ? rx - m_view_distance : 0;
+    const unsigned min_y = ry >= m_view_distance ? ry - m_view_distance : 0;
+    const unsigned max_x = std::min( rx + m_view_distance, width() - 1 );
+    const unsigned max_y = std::min( ry + m_view_distance, height() - 1 );
+
+    for( unsigned y = min_y; y <= max_y; ++y )
+    {
+        for( unsigned x = min_x; x <= max_x; ++x )
+        {
+            if( !visibility_map.is_visible( x, y ) )
+                continue;
 
+            robot.remember( x, y, m_obstacle_map.at( x, y ) );
+        }
+    }
 }
 
 /* Increase this number after modifying the serialization format. */
@@ -243,7 +763,7 @@ void Scene::serialize( QDataStream& stream ) const
     stream << (uint32_t)m_last_robot_id;
 }
 
-void Scene::deserialize( QDataStream& stream )
+bool Scene::deserialize( QDataStream& stream )
 {
     stream.setByteOrder( QDataStream::LittleEndian );
 
@@ -251,19 +771,34 @@ void Scene::deserialize( QDataStream& stream )
     stream >> version;
 
     if( version != file_format_version )
-        return;
+        return false;
 
     uint32_t width, height;
     stream >> width;
     stream >> height;
 
     if( width > 0xffff || height > 0xffff || width == 0 || height == 0 )
-        return;
+        return false;
 
     m_obstacle_map = Array2d< ObstacleType >( width, height );
+    m_robot_map = Array2d< Robot * >( width, height, nullptr );
     stream.readRawData( (char *)m_obstacle_map.vector().data(), width * height );
 
+    m_built_cluster_graph.store( nullptr, std::memory_order_relaxed );
+    m_cluster_graph.reset();
+    m_flow_fields.clear();
+    m_wall_plane = BitPlane( width, height );
+    m_robot_plane = BitPlane( width, height );
+    m_wall_pyramid = OccupancyPyramid( width, height );
+    for( unsigned y = 0; y < height; ++y )
+    {
+        for( unsigned x = 0; x < width; ++x )
+            set_obstacle( x, y, m_obstacle_map.at( x, y ) );
+    }
+
     m_robot_list.clear();
+    m_robot_states.clear();
+    m_reservations.clear();
     uint32_t robot_count;
     stream >> robot_count;
 
@@ -277,8 +812,16 @@ void Scene::deserialize( QDataStream& stream )
         stream >> goal_x;
         stream >> goal_y;
 
-        m_robot_list.emplace_back( id, x, y, *this );
+        if( x >= width || y >= height )
+            return false;
+
+        m_robot_states.push_back( id, x, y );
+        m_robot_list.emplace_back( m_robot_states.size() - 1, *this );
+
         Robot& robot = m_robot_list.back();
+        m_robot_states.robot.back() = &robot;
+        set_obstacle( x, y, ObstacleType::Robot );
+        m_robot_map.at( x, y ) = &robot;
         if( goal_x >= width || goal_y >= height )
             robot.clear_goal();
         else
@@ -288,5 +831,11 @@ void Scene::deserialize( QDataStream& stream )
     uint32_t last_robot_id;
     stream >> last_robot_id;
     m_last_robot_id = last_robot_id;
+
+    invalidate_visibility();
+    m_dirty_blocks.clear();
+    m_all_blocks_dirty = true;
+
+    return stream.status() == QDataStream::Ok;
 }
 
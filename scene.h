@@ -5,12 +5,22 @@
 #include <vector>
 #include <memory>
 #include <list>
+#include <mutex>
+#include <atomic>
 
 #include <QDataStream>
 
 #include "array2d.h"
+#include "bitplane.h"
+#include "occupancypyramid.h"
+#include "clustergraph.h"
+#include "flowfieldcache.h"
+#include "reservationtable.h"
 
 class Robot;
+class RoutingAlgorithm;
+class VisibilityWindow;
+class ThreadPool;
 
 enum class ObstacleType : uint8_t
 {
@@ -19,14 +29,108 @@ enum class ObstacleType : uint8_t
     Robot = 2
 };
 
+enum class VisibilityAlgorithm
+{
+    /* Exact, symmetric field of view using only integer math. */
+    Shadowcasting,
+
+    /* The original approximation which marches a fixed number of rays. */
+    RayMarching
+};
+
+/**
+ * @brief State of every robot in a Scene that is touched each
+ *        simulation tick, stored as parallel arrays indexed by
+ *        Robot::index() so that the simulation can stream through it.
+ */
+struct RobotStates
+{
+    std::vector< unsigned > id;
+    std::vector< unsigned > x, y;
+    std::vector< unsigned > goal_x, goal_y;
+    std::vector< float > frac_x, frac_y;
+
+    /* Whenever the robot has both a goal and a routing algorithm. */
+    std::vector< uint8_t > active;
+
+    /* Whenever the robot is already queued for a visibility update. */
+    std::vector< uint8_t > visibility_dirty;
+
+    std::vector< RoutingAlgorithm * > algorithm;
+    std::vector< Robot * > robot;
+
+    /* Grows whenever a robot is added or removed, or its routing algorithm is changed. */
+    unsigned algorithm_version;
+
+    explicit RobotStates();
+
+    /**
+     * @return Number of robots.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Appends a new robot with no goal and no routing algorithm.
+     */
+    void push_back( const unsigned robot_id, const unsigned robot_x, const unsigned robot_y );
+
+    /**
+     * @brief Removes the robot at @a index, preserving the order of the rest.
+     */
+    void erase( const std::size_t index );
+
+    /**
+     * @brief Removes every robot.
+     */
+    void clear();
+};
+
 class Scene
 {
     friend class Robot;
 
     Array2d< ObstacleType > m_obstacle_map;
+    Array2d< Robot * > m_robot_map;
+
+    /* Packed copies of the obstacle map; one bit per block. */
+    BitPlane m_wall_plane;
+    BitPlane m_robot_plane;
+
+    /* Coarse summary of the wall plane. */
+    OccupancyPyramid m_wall_pyramid;
+
+    /* Built on first use, since most algorithms don't need it; the lock is only taken until it's published. */
+    mutable std::unique_ptr< ClusterGraph > m_cluster_graph;
+    mutable std::atomic< const ClusterGraph * > m_built_cluster_graph;
+    mutable std::mutex m_cluster_graph_mutex;
+
+    mutable FlowFieldCache m_flow_fields;
+
+    /* Declared before the robots, since their algorithms release their reservations when destroyed. */
+    mutable ReservationTable m_reservations;
+
+    RobotStates m_robot_states;
     std::list< Robot > m_robot_list;
     unsigned m_last_robot_id;
 
+    unsigned m_view_distance;
+    VisibilityAlgorithm m_visibility_algorithm;
+
+    std::vector< std::pair< unsigned, unsigned > > m_changed_cells;
+    std::vector< std::size_t > m_visibility_queue;
+    bool m_visibility_invalidated;
+
+    /* Blocks whose obstacle has changed since the last take_dirty_blocks(). */
+    std::vector< std::pair< unsigned, unsigned > > m_dirty_blocks;
+    bool m_all_blocks_dirty;
+
+    void erase_robot( Robot& robot );
+    void mark_changed( const unsigned x, const unsigned y );
+    void set_obstacle( const unsigned x, const unsigned y, const ObstacleType type );
+
+    void cast_rays( const unsigned origin_x, const unsigned origin_y, VisibilityWindow& visibility_map ) const;
+    void cast_shadows( const unsigned origin_x, const unsigned origin_y, VisibilityWindow& visibility_map ) const;
+
     public:
 
         explicit Scene( const unsigned width, const unsigned height );
@@ -52,6 +156,16 @@ class Scene
          */
         const std::list< Robot >& robot_list() const;
 
+        /**
+         * @return Per-robot simulation state, in the same order as robot_list().
+         */
+        RobotStates& robot_states();
+
+        /**
+         * @return Per-robot simulation state, in the same order as robot_list().
+         */
+        const RobotStates& robot_states() const;
+
         /**
          * @brief Adds a wall at given point; does nothing
          *        in case of an already occupied block.
@@ -106,11 +220,110 @@ class Scene
          */
         bool is_blocked( const unsigned x, const unsigned y ) const;
 
+        /**
+         * @return Bit plane with a bit set for every wall.
+         */
+        const BitPlane& wall_plane() const;
+
+        /**
+         * @return Bit plane with a bit set for every robot.
+         */
+        const BitPlane& robot_plane() const;
+
+        /**
+         * @return Number of walls in every 8x8, 16x16, 32x32, ... area.
+         */
+        const OccupancyPyramid& wall_pyramid() const;
+
+        /**
+         * @return Graph of the clusters of the walls, for finding long
+         *         paths; built on the first call, which is safe to make
+         *         from multiple threads at once, and kept up to date
+         *         with the walls from then on.
+         */
+        const ClusterGraph& cluster_graph() const;
+
+        /**
+         * @return Flow fields of the goals the robots are heading for,
+         *         worked out over the walls and shared between them.
+         */
+        FlowFieldCache& flow_field_cache() const;
+
+        /**
+         * @return Blocks the robots have reserved for the next few
+         *         moments; the simulation moves its time forward.
+         */
+        ReservationTable& reservation_table() const;
+
+        /**
+         * @return Whenever every block of a given rectangle is inside
+         *         of the scene and isn't occupied.
+         */
+        bool is_area_free( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const;
+
+        /**
+         * @return Number of occupied blocks in a given rectangle;
+         *         the parts outside of the scene are ignored.
+         */
+        unsigned count_obstacles( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const;
+
+        /**
+         * @return Whenever a straight line between the centers of two blocks
+         *         doesn't touch any occupied block; the two blocks themselves
+         *         aren't checked.
+         */
+        bool has_line_of_sight( const unsigned x0, const unsigned y0, const unsigned x1, const unsigned y1 ) const;
+
+        /**
+         * @return How far the robots can see, in blocks.
+         */
+        unsigned view_distance() const;
+
+        /**
+         * @brief Sets how far the robots can see, in blocks.
+         */
+        void set_view_distance( const unsigned distance );
+
+        /**
+         * @return Algorithm used to calculate the robots' field of view.
+         */
+        VisibilityAlgorithm visibility_algorithm() const;
+
+        /**
+         * @brief Sets the algorithm used to calculate the robots' field of view.
+         */
+        void set_visibility_algorithm( const VisibilityAlgorithm algorithm );
+
         /**
          * @brief Recalculates field of view for given robot.
          */
         void calculate_visibility_for( Robot& robot ) const;
 
+        /**
+         * @brief Recalculates field of view of every robot which
+         *        can see a block that has changed since the last call.
+         * @param thread_pool Pool to split the robots between; if null
+         *        everything runs on the calling thread.
+         */
+        void update_visibility( ThreadPool * thread_pool = nullptr );
+
+        /**
+         * @brief Makes the next update_visibility() recalculate
+         *        the field of view of every robot.
+         */
+        void invalidate_visibility();
+
+        /**
+         * @brief Moves the blocks whose obstacle has changed since
+         *        the last call into @a o_blocks; a block may be
+         *        listed more than once.
+         * @return Whenever every block should be treated as changed,
+         *         either because the whole scene was replaced or too
+         *         many blocks have changed to keep track of them.
+         *         @a o_blocks is left empty then.
+         */
+        bool take_dirty_blocks( std::vector< std::pair< unsigned, unsigned > >& o_blocks );
+
         /**
          * @brief Serializes the whole scene to a data stream.
          */
@@ -118,8 +331,9 @@ class Scene
 
         /**
          * @brief Deserializes the whole scene from a data stream.
+         * @return Whenever the operation was successful.
          */
-        void deserialize( QDataStream& stream );
+        bool deserialize( QDataStream& stream );
 };
 
 #endif // SCENE_H
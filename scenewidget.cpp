@@ -1,15 +1,35 @@
 #include "scenewidget.h"
 #include "scene.h"
-#include "robot.h"
+#include "rendersnapshot.h"
+#include "simulationthread.h"
 
 #include <QPainter>
 #include <QPaintEvent>
 
-SceneWidget::SceneWidget( const std::shared_ptr< Scene > scene, QWidget * parent ) : QWidget( parent ),
+#include <math.h>
+#include <algorithm>
+
+static const QRgb empty_color = qRgb( 0xff, 0xff, 0xff );
+static const QRgb wall_color = qRgb( 0x88, 0xff, 0x88 );
+static const QRgb unknown_color = qRgb( 0x55, 0x55, 0x55 );
+static const QRgb border_rgb = qRgb( 0xaa, 0xaa, 0xaa );
+
+/* The static layer is never made bigger than this in either dimension. */
+static const unsigned max_static_layer_size = 4096;
+
+SceneWidget::SceneWidget( QWidget * parent ) : QWidget( parent ),
     m_block_size( 32 ),
     m_scale_factor( 1.0f, 1.0f ),
-    m_selected_robot( nullptr ),
-    m_scene( scene ),
+    m_has_selected_robot( false ),
+    m_selected_robot_id( 0 ),
+    m_snapshot( nullptr ),
+    m_obstacle_map( 0, 0 ),
+    m_previous_show_selected_robot( false ),
+    m_wall_pyramid( 0, 0 ),
+    m_layer_block_size( 0 ),
+    m_layer_level( -1 ),
+    m_is_static_layer_valid( false ),
+    m_labels( 4096 ),
     m_interaction_mode( InteractionMode::None )
 {
 }
@@ -22,150 +42,556 @@ void SceneWidget::set_interaction_mode( InteractionMode mode )
 {
     m_interaction_mode = mode;
 
-    if( m_selected_robot != nullptr )
-        repaint();
+    /* Setting goals shows the walls the selected robot can't see. */
+    if( m_has_selected_robot )
+    {
+        m_is_static_layer_valid = false;
+        update();
+    }
 }
 
-void SceneWidget::paintEvent( QPaintEvent * )
+void SceneWidget::set_snapshot( const RenderSnapshot& snapshot )
 {
-    /* TODO: Redraw only dirty regions. */
+    /* Beyond this many rectangles a region gets slower to build than to simply redraw everything. */
+    const std::size_t max_dirty_rects = 256;
 
-    const QRect rect( QPoint(), this->size() );
-    QPainter ctx( this );
-    ctx.setRenderHint( QPainter::Antialiasing );
+    std::vector< QRectF > dirty_rects;
+    bool everything_dirty = snapshot.full_update;
 
-    ctx.setBrush( QBrush(Qt::white) );
-    ctx.drawRect( rect );
+    if( snapshot.full_update )
+    {
+        m_obstacle_map = snapshot.obstacle_map;
+        m_wall_pyramid = OccupancyPyramid( m_obstacle_map.width(), m_obstacle_map.height() );
+        m_wall_pyramid.build( [this]( const unsigned x, const unsigned y ) {
+            return m_obstacle_map.at( x, y ) == ObstacleType::Wall;
+        });
+    }
+    else
+    {
+        for( const BlockChange& change: snapshot.changed_blocks )
+        {
+            ObstacleType& obstacle = m_obstacle_map.at( change.x, change.y );
+            if( obstacle != ObstacleType::Wall && change.type == ObstacleType::Wall )
+                m_wall_pyramid.increment( change.x, change.y );
+            else if( obstacle == ObstacleType::Wall && change.type != ObstacleType::Wall )
+                m_wall_pyramid.decrement( change.x, change.y );
 
-    const QColor border_color = QColor( 0xaa, 0xaa, 0xaa );
+            obstacle = change.type;
 
-    ctx.setPen( QPen( border_color, 1 ) );
-    QTransform view_matrix( m_scale_factor.x(), 0, 0,
-                            0, m_scale_factor.y(), 0,
-                            m_scale_factor.x() * m_translation.x(), m_scale_factor.y() * m_translation.y(), 1 );
+            /* A layer made from the wall pyramid shows a change over the whole area it is in. */
+            if( m_layer_level >= 0 )
+            {
+                const unsigned area_size = OccupancyPyramid::area_size( m_layer_level );
+                dirty_rects.push_back( block_rect( change.x & ~(area_size - 1), change.y & ~(area_size - 1), area_size, area_size ) );
+            }
+            else
+                dirty_rects.push_back( block_rect( change.x, change.y ) );
+        }
+    }
 
-    ctx.setTransform( view_matrix );
+    auto is_same = []( const RobotSnapshot& a, const RobotSnapshot& b ) {
+        return a.id == b.id && a.x == b.x && a.y == b.y && a.frac_x == b.frac_x && a.frac_y == b.frac_y &&
+               a.has_goal == b.has_goal && a.goal_x == b.goal_x && a.goal_y == b.goal_y;
+    };
+
+    auto mark_robot = [this, &dirty_rects]( const RobotSnapshot& robot ) {
+        dirty_rects.push_back( robot_rect( robot ) );
+        if( robot.has_goal )
+            dirty_rects.push_back( block_rect( robot.goal_x, robot.goal_y ) );
+    };
+
+    /* The robots are kept in the same order, so usually only a few of them differ. */
+    const std::size_t robot_count = std::max( snapshot.robots.size(), m_previous_robots.size() );
+    for( std::size_t i = 0; i < robot_count && dirty_rects.size() <= max_dirty_rects; ++i )
+    {
+        const bool has_previous = i < m_previous_robots.size();
+        const bool has_current = i < snapshot.robots.size();
+        if( has_previous && has_current && is_same( m_previous_robots[ i ], snapshot.robots[ i ] ) )
+            continue;
 
-    /* Draw horizontal lines. */
-    for( unsigned y = 0; y <= m_scene->height(); ++y )
+        if( has_previous )
+            mark_robot( m_previous_robots[ i ] );
+
+        if( has_current )
+            mark_robot( snapshot.robots[ i ] );
+    }
+
+    m_snapshot = &snapshot;
+    m_previous_robots = snapshot.robots;
+
+    /* What the selected robot knows and sees only changes around itself. */
+    const bool show_selected_robot = shows_selected_robot();
+    QRect selected_view;
+    if( show_selected_robot )
     {
-        const QLineF line( 0, y * m_block_size, m_scene->width() * m_block_size, y * m_block_size );
-        ctx.drawLine( line );
+        const VisibilityWindow& window = snapshot.selected_visibility_map;
+        selected_view = QRect( int( window.center_x() ) - int( window.radius() ), int( window.center_y() ) - int( window.radius() ),
+                               window.radius() * 2 + 1, window.radius() * 2 + 1 );
     }
 
-    /* Draw vertical lines. */
-    for( unsigned x = 0; x <= m_scene->width(); ++x )
+    /* Even when it stands still, a change nearby can change what it sees. */
+    if( show_selected_robot != m_previous_show_selected_robot )
+        everything_dirty = true;
+    else if( show_selected_robot )
     {
-        const QLineF line( x * m_block_size, 0, x * m_block_size, m_scene->height() * m_block_size );
-        ctx.drawLine( line );
+        for( const QRect& view: { m_previous_selected_view, selected_view } )
+            dirty_rects.push_back( QRectF( view.x() * float( m_block_size ), view.y() * float( m_block_size ),
+                                           view.width() * float( m_block_size ), view.height() * float( m_block_size ) ) );
     }
 
-    const Array2d< ObstacleType >& obstacle_map = [this]() -> const Array2d< ObstacleType >& {
-        if( m_selected_robot )
-            return m_selected_robot->obstacle_map();
-        else
-            return m_scene->obstacle_map();
-    }();
+    if( everything_dirty )
+        m_is_static_layer_valid = false;
+    else if( m_is_static_layer_valid )
+    {
+        for( const BlockChange& change: snapshot.changed_blocks )
+            paint_static_layer( change.x, change.y, change.x + 1, change.y + 1 );
+
+        if( show_selected_robot )
+        {
+            for( const QRect& view: { m_previous_selected_view, selected_view } )
+                paint_static_layer( std::max( view.x(), 0 ), std::max( view.y(), 0 ), view.x() + view.width(), view.y() + view.height() );
+        }
+    }
+
+    m_previous_show_selected_robot = show_selected_robot;
+    m_previous_selected_view = selected_view;
+
+    if( everything_dirty || dirty_rects.size() > max_dirty_rects )
+    {
+        update();
+        return;
+    }
+
+    QRegion region;
+    for( const QRectF& rect: dirty_rects )
+        region += to_screen_space( rect );
+
+    update( region );
+}
+
+bool SceneWidget::shows_selected_robot() const
+{
+    /* The snapshot might still be of the robot selected before. */
+    return m_snapshot != nullptr && m_has_selected_robot && m_snapshot->has_selected_robot &&
+           m_snapshot->selected_robot_id == m_selected_robot_id;
+}
+
+QRectF SceneWidget::block_rect( const unsigned x, const unsigned y, const unsigned width, const unsigned height ) const
+{
+    return QRectF( x * float( m_block_size ), y * float( m_block_size ), width * float( m_block_size ), height * float( m_block_size ) );
+}
+
+/* The area a robot and its label are drawn in, in world space. */
+QRectF SceneWidget::robot_rect( const RobotSnapshot& robot ) const
+{
+    return QRectF( (robot.x + robot.frac_x - 0.5f) * m_block_size, (robot.y + robot.frac_y - 0.5f) * m_block_size, m_block_size, m_block_size );
+}
 
-    auto is_visible = [this]( unsigned x, unsigned y ) {
-        return !m_selected_robot || m_selected_robot->can_see( x, y ) || m_interaction_mode == InteractionMode::SetGoal;
+/* The blocks which overlap a rectangle in world space, clipped to the map. */
+QRect SceneWidget::visible_blocks( const QRectF& world_rect ) const
+{
+    auto to_block = [this]( const double position, const unsigned limit ) {
+        return (unsigned)std::min( std::max( floor( position / m_block_size ), 0.0 ), double( limit ) );
     };
 
-    auto loop_through = [this, is_visible, &obstacle_map]( std::function< void (const ObstacleType, const bool, const unsigned x, const unsigned y) > callback ) {
-        for( unsigned y = 0; y < m_scene->height(); ++y )
+    const unsigned min_x = to_block( world_rect.left(), m_obstacle_map.width() );
+    const unsigned min_y = to_block( world_rect.top(), m_obstacle_map.height() );
+    const unsigned max_x = to_block( world_rect.right() + m_block_size, m_obstacle_map.width() );
+    const unsigned max_y = to_block( world_rect.bottom() + m_block_size, m_obstacle_map.height() );
+
+    return QRect( min_x, min_y, max_x - min_x, max_y - min_y );
+}
+
+QRect SceneWidget::to_screen_space( const QRectF& rect ) const
+{
+    const QRectF screen_rect( m_scale_factor.x() * (rect.x() + m_translation.x()),
+                              m_scale_factor.y() * (rect.y() + m_translation.y()),
+                              m_scale_factor.x() * rect.width(),
+                              m_scale_factor.y() * rect.height() );
+
+    /* Leave some space for the antialiased borders. */
+    return screen_rect.toAlignedRect().adjusted( -2, -2, 2, 2 );
+}
+
+void SceneWidget::set_command_handler( const CommandHandler& handler )
+{
+    m_command_handler = handler;
+}
+
+bool SceneWidget::post( const SceneCommand& command )
+{
+    if( !m_command_handler )
+        return false;
+
+    return m_command_handler( command );
+}
+
+const RobotSnapshot * SceneWidget::find_robot( const unsigned x, const unsigned y ) const
+{
+    if( m_snapshot == nullptr )
+        return nullptr;
+
+    const RobotSnapshot * found = nullptr;
+    m_snapshot->robot_grid.for_each_near( x, y, x + 1, y + 1, [this, x, y, &found]( const unsigned index ) {
+        const RobotSnapshot& robot = m_snapshot->robots[ index ];
+        if( found == nullptr && robot.x == x && robot.y == y )
+            found = &robot;
+    });
+
+    return found;
+}
+
+QRgb SceneWidget::block_color( const unsigned x, const unsigned y, const bool show_selected_robot ) const
+{
+    const bool can_see = !show_selected_robot || m_snapshot->selected_visibility_map.is_visible( x, y );
+    const bool is_visible = can_see || m_interaction_mode == InteractionMode::SetGoal;
+
+    if( is_visible )
+    {
+        const ObstacleType obstacle_type = show_selected_robot ? m_snapshot->selected_obstacle_map.at( x, y ) : m_obstacle_map.at( x, y );
+        if( obstacle_type == ObstacleType::Wall )
+            return wall_color;
+    }
+
+    return can_see ? empty_color : unknown_color;
+}
+
+void SceneWidget::build_static_layer()
+{
+    const unsigned width = m_obstacle_map.width();
+    const unsigned height = m_obstacle_map.height();
+
+    m_is_static_layer_valid = true;
+    if( width == 0 || height == 0 )
+    {
+        m_static_layer = QImage();
+        return;
+    }
+
+    QSize size;
+    if( width <= max_static_layer_size && height <= max_static_layer_size )
+    {
+        /* Big maps get fewer pixels per block, so that the image stays within its size limit. */
+        m_layer_block_size = std::max( 1u, std::min( m_block_size, max_static_layer_size / std::max( width, height ) ) );
+        m_layer_level = -1;
+        size = QSize( width * m_layer_block_size + 1, height * m_layer_block_size + 1 );
+    }
+    else
+    {
+        m_layer_level = 0;
+        while( m_wall_pyramid.level_width( m_layer_level ) > max_static_layer_size ||
+               m_wall_pyramid.level_height( m_layer_level ) > max_static_layer_size )
+            m_layer_level++;
+
+        size = QSize( m_wall_pyramid.level_width( m_layer_level ), m_wall_pyramid.level_height( m_layer_level ) );
+    }
+
+    if( m_static_layer.size() != size )
+        m_static_layer = QImage( size, QImage::Format_RGB32 );
+
+    /* The bottom and the right edge of the grid. */
+    m_static_layer.fill( border_rgb );
+    paint_static_layer( 0, 0, width, height );
+}
+
+/*
+ * Redraws the blocks in [min_x, max_x) x [min_y, max_y) of the static layer,
+ * each of which also owns the grid lines along its top and left edge.
+ */
+void SceneWidget::paint_static_layer( unsigned min_x, unsigned min_y, unsigned max_x, unsigned max_y )
+{
+    if( m_static_layer.isNull() )
+        return;
+
+    max_x = std::min( max_x, m_obstacle_map.width() );
+    max_y = std::min( max_y, m_obstacle_map.height() );
+
+    if( m_layer_level >= 0 )
+    {
+        paint_coarse_static_layer( min_x, min_y, max_x, max_y );
+        return;
+    }
+
+    const bool show_selected_robot = shows_selected_robot();
+    const unsigned block_size = m_layer_block_size;
+
+    /* Grid lines closer together than this would only turn the whole map grey. */
+    const bool has_grid = block_size >= 4;
+
+    for( unsigned y = min_y; y < max_y; ++y )
+    {
+        for( unsigned row = 0; row < block_size; ++row )
         {
-            for( unsigned x = 0; x < m_scene->width(); ++x )
+            QRgb * pixels = reinterpret_cast< QRgb * >( m_static_layer.scanLine( y * block_size + row ) );
+            for( unsigned x = min_x; x < max_x; ++x )
             {
-                ObstacleType obstacle_type = obstacle_map.at( x, y );
-                const bool can_see = is_visible( x, y );
+                const QRgb color = block_color( x, y, show_selected_robot );
+                QRgb * block_pixels = pixels + x * block_size;
 
-                if( !can_see )
-                    obstacle_type = ObstacleType::None;
+                if( has_grid && row == 0 )
+                {
+                    std::fill( block_pixels, block_pixels + block_size, border_rgb );
+                    continue;
+                }
 
-                callback( obstacle_type, can_see, x, y );
+                std::fill( block_pixels, block_pixels + block_size, color );
+                if( has_grid )
+                    block_pixels[ 0 ] = border_rgb;
             }
         }
-    };
+    }
+}
 
-    loop_through( [this, &ctx, &border_color](const ObstacleType obstacle_type, const bool, const unsigned x, const unsigned y) {
+/*
+ * Redraws the pixels of a static layer made from the wall pyramid which
+ * cover the blocks in [min_x, max_x) x [min_y, max_y); what the selected
+ * robot knows isn't shown at this scale.
+ */
+void SceneWidget::paint_coarse_static_layer( const unsigned min_x, const unsigned min_y, const unsigned max_x, const unsigned max_y )
+{
+    if( min_x >= max_x || min_y >= max_y )
+        return;
+
+    const unsigned level = m_layer_level;
+    const unsigned shift = OccupancyPyramid::base_shift + level;
+    const float area = float( OccupancyPyramid::area_size( level ) ) * OccupancyPyramid::area_size( level );
 
-        switch( obstacle_type )
+    for( unsigned y = min_y >> shift; y <= (max_y - 1) >> shift; ++y )
+    {
+        QRgb * pixels = reinterpret_cast< QRgb * >( m_static_layer.scanLine( y ) );
+        for( unsigned x = min_x >> shift; x <= (max_x - 1) >> shift; ++x )
         {
-            case ObstacleType::Wall:
+            const unsigned count = m_wall_pyramid.count( level, x, y );
+            if( count == 0 )
             {
-                ctx.setPen( QPen( border_color, 1 ) );
-                ctx.setBrush( QBrush( QColor( 0x88, 0xff, 0x88 ) ) );
-                ctx.drawRect( QRect( x * m_block_size, y * m_block_size, m_block_size, m_block_size ) );
-                break;
+                pixels[ x ] = empty_color;
+                continue;
             }
 
-            case ObstacleType::None:
+            /* Even a single wall should stand out. */
+            const float amount = std::min( 0.25f + 0.75f * count / area, 1.0f );
+            auto mix = [amount]( const int empty, const int wall ) {
+                return int( empty + (wall - empty) * amount );
+            };
+
+            pixels[ x ] = qRgb( mix( qRed( empty_color ), qRed( wall_color ) ),
+                                mix( qGreen( empty_color ), qGreen( wall_color ) ),
+                                mix( qBlue( empty_color ), qBlue( wall_color ) ) );
+        }
+    }
+}
+
+const QPixmap * SceneWidget::label( const unsigned id, const bool is_goal, const QRgb color )
+{
+    const quint64 key = (quint64( id ) << 32) | (quint64( is_goal ) << 24) | (color & 0xffffff);
+    if( QPixmap * cached = m_labels.object( key ) )
+        return cached;
+
+    /* The robot's id is centered over it, the goal's is put into a corner. */
+    const int size = is_goal ? m_block_size / 2 : m_block_size;
+    QPixmap * pixmap = new QPixmap( size, size );
+    pixmap->fill( Qt::transparent );
+
+    QPainter ctx( pixmap );
+    ctx.setPen( QColor( color ) );
+    ctx.drawText( 0, 0, size, size, is_goal ? 0 : Qt::AlignCenter | Qt::AlignVCenter, QString::number( id ) );
+    ctx.end();
+
+    m_labels.insert( key, pixmap );
+    return pixmap;
+}
+
+void SceneWidget::paintEvent( QPaintEvent * event )
+{
+    QPainter ctx( this );
+    ctx.setRenderHint( QPainter::Antialiasing );
+
+    if( m_snapshot != nullptr && !m_is_static_layer_valid )
+        build_static_layer();
+
+    /*
+     * Every rectangle of the region is drawn on its own, and only into
+     * itself, so that two changes far apart don't redraw everything
+     * between them too.
+     */
+    for( const QRect& rect: event->region() )
+    {
+        ctx.resetTransform();
+        ctx.setClipRect( rect );
+        paint_area( ctx, rect );
+    }
+}
+
+void SceneWidget::paint_area( QPainter& ctx, const QRect& rect )
+{
+    ctx.fillRect( rect, Qt::white );
+
+    if( m_snapshot == nullptr )
+        return;
+
+    const RenderSnapshot& snapshot = *m_snapshot;
+    const bool show_selected_robot = shows_selected_robot();
+
+    /* Only the blocks inside of the area which needs to be redrawn are touched. */
+    const QRectF world_rect( to_world_space( rect.topLeft() ), to_world_space( rect.bottomRight() + QPoint( 1, 1 ) ) );
+    const QRect blocks = visible_blocks( world_rect );
+    const unsigned min_x = blocks.left();
+    const unsigned min_y = blocks.top();
+    const unsigned max_x = blocks.left() + blocks.width();
+    const unsigned max_y = blocks.top() + blocks.height();
+
+    const QColor border_color = QColor( border_rgb );
+
+    ctx.setPen( QPen( border_color, 1 ) );
+    QTransform view_matrix( m_scale_factor.x(), 0, 0,
+                            0, m_scale_factor.y(), 0,
+                            m_scale_factor.x() * m_translation.x(), m_scale_factor.y() * m_translation.y(), 1 );
+
+    ctx.setTransform( view_matrix );
+
+    /*
+     * When zoomed in further than the static layer's resolution it would
+     * look blocky, but then there are only a few blocks on the screen
+     * anyway, so they are drawn directly instead. A layer made from the
+     * wall pyramid is only meant for blocks smaller than a pixel or two.
+     */
+    const float screen_block_size = std::max( m_scale_factor.x(), m_scale_factor.y() ) * m_block_size;
+    const bool use_static_layer = !m_static_layer.isNull() &&
+                                  screen_block_size <= (m_layer_level >= 0 ? 2.0f : float( m_layer_block_size ));
+
+    if( use_static_layer && m_layer_level >= 0 )
+    {
+        const unsigned area_size = OccupancyPyramid::area_size( m_layer_level );
+        const unsigned layer_x = min_x / area_size;
+        const unsigned layer_y = min_y / area_size;
+        const unsigned layer_width = std::min( (max_x + area_size - 1) / area_size, unsigned( m_static_layer.width() ) ) - layer_x;
+        const unsigned layer_height = std::min( (max_y + area_size - 1) / area_size, unsigned( m_static_layer.height() ) ) - layer_y;
+        const float scale = float( m_block_size ) * area_size;
+
+        ctx.drawImage( QRectF( layer_x * scale, layer_y * scale, layer_width * scale, layer_height * scale ),
+                       m_static_layer, QRectF( layer_x, layer_y, layer_width, layer_height ) );
+    }
+    else if( use_static_layer )
+    {
+        const unsigned layer_x = min_x * m_layer_block_size;
+        const unsigned layer_y = min_y * m_layer_block_size;
+        const unsigned layer_width = std::min( max_x * m_layer_block_size + 1, unsigned( m_static_layer.width() ) ) - layer_x;
+        const unsigned layer_height = std::min( max_y * m_layer_block_size + 1, unsigned( m_static_layer.height() ) ) - layer_y;
+        const float scale = float( m_block_size ) / m_layer_block_size;
+
+        ctx.drawImage( QRectF( layer_x * scale, layer_y * scale, layer_width * scale, layer_height * scale ),
+                       m_static_layer, QRectF( layer_x, layer_y, layer_width, layer_height ) );
+    }
+    else
+    {
+        /* Draw horizontal lines. */
+        for( unsigned y = min_y; y <= max_y; ++y )
+        {
+            const QLineF line( min_x * m_block_size, y * m_block_size, max_x * m_block_size, y * m_block_size );
+            ctx.drawLine( line );
+        }
+
+        /* Draw vertical lines. */
+        for( unsigned x = min_x; x <= max_x; ++x )
+        {
+            const QLineF line( x * m_block_size, min_y * m_block_size, x * m_block_size, max_y * m_block_size );
+            ctx.drawLine( line );
+        }
+
+        for( unsigned y = min_y; y < max_y; ++y )
+        {
+            for( unsigned x = min_x; x < max_x; ++x )
             {
-                if( m_selected_robot && !m_selected_robot->can_see( x, y ) )
-                {
-                    ctx.setPen( QPen( border_color ) );
-                    ctx.setBrush( QBrush( QColor( 0x55, 0x55, 0x55 ) ) );
-                    ctx.drawRect( QRect( x * m_block_size, y * m_block_size, m_block_size, m_block_size ) );
-                }
-                break;
-            }
+                const QRgb color = block_color( x, y, show_selected_robot );
+                if( color == empty_color )
+                    continue;
 
-            case ObstacleType::Robot:
-                break;
+                ctx.setBrush( QBrush( QColor( color ) ) );
+                ctx.drawRect( QRect( x * m_block_size, y * m_block_size, m_block_size, m_block_size ) );
+            }
         }
+    }
 
-    });
+    auto obstacle_at = [this, &snapshot, show_selected_robot]( unsigned x, unsigned y ) {
+        if( show_selected_robot )
+            return snapshot.selected_obstacle_map.at( x, y );
+        else
+            return m_obstacle_map.at( x, y );
+    };
 
-    loop_through( [this, &ctx, &border_color](const ObstacleType obstacle_type, const bool can_see, const unsigned x, const unsigned y) {
-        if( obstacle_type != ObstacleType::Robot )
-            return;
+    auto can_see = [&snapshot, show_selected_robot]( unsigned x, unsigned y ) {
+        return !show_selected_robot || snapshot.selected_visibility_map.is_visible( x, y );
+    };
 
-        const Robot * robot = m_scene->get_robot( x, y );
+    auto is_visible = [this, can_see]( unsigned x, unsigned y ) {
+        return can_see( x, y ) || m_interaction_mode == InteractionMode::SetGoal;
+    };
 
+    auto draw_robot = [this, &ctx, &border_color]( const unsigned x, const unsigned y, const RobotSnapshot * robot ) {
         float frac_x = 0.5;
         float frac_y = 0.5;
 
-        if( can_see && robot != nullptr )
+        if( robot != nullptr )
         {
-            frac_x = robot->frac_x();
-            frac_y = robot->frac_y();
+            frac_x = robot->frac_x;
+            frac_y = robot->frac_y;
         }
 
         ctx.setPen( QPen( border_color, 1 ) );
         ctx.setBrush( QBrush( QColor(0x62, 0xa2, 0xf3) ) );
         ctx.drawEllipse( QPoint( (x + frac_x) * m_block_size, (y + frac_y) * m_block_size ), m_block_size / 3, m_block_size / 3 );
-        if( m_selected_robot == robot )
-            ctx.setPen( QPen( Qt::yellow ) );
-        else
-            ctx.setPen( QPen( Qt::white ) );
 
-        if( can_see && robot != nullptr )
+        if( robot != nullptr )
         {
-            QString id = QString::number( robot->id() );
-            ctx.drawText( (x + frac_x - 0.5) * m_block_size, (y + frac_y - 0.5) * m_block_size, m_block_size, m_block_size, Qt::AlignCenter | Qt::AlignVCenter, id );
+            const bool is_selected = m_has_selected_robot && robot->id == m_selected_robot_id;
+            const QPixmap * id = label( robot->id, false, is_selected ? qRgb( 0xff, 0xff, 0x00 ) : qRgb( 0xff, 0xff, 0xff ) );
+            if( id != nullptr )
+                ctx.drawPixmap( QPointF( (x + frac_x - 0.5) * m_block_size, (y + frac_y - 0.5) * m_block_size ), *id );
         }
+    };
 
+    /* Robots which are actually there; they can stick out of their block by up to one block. */
+    snapshot.robot_grid.for_each_near( min_x > 0 ? min_x - 1 : 0, min_y > 0 ? min_y - 1 : 0, max_x + 1, max_y + 1, [&]( const unsigned index ) {
+        const RobotSnapshot& robot = snapshot.robots[ index ];
+        if( !world_rect.intersects( robot_rect( robot ) ) )
+            return;
+
+        if( is_visible( robot.x, robot.y ) && obstacle_at( robot.x, robot.y ) == ObstacleType::Robot )
+            draw_robot( robot.x, robot.y, &robot );
     });
 
-    /* TODO: If two or more goals are set to the same title draw multiple ids. */
-    for( const Robot& robot: m_scene->robot_list() )
+    /* Robots the selected robot remembers, but which have since moved. */
+    if( show_selected_robot )
     {
-        if( !robot.has_goal() )
-            continue;
+        snapshot.remembered_robot_grid.for_each_near( min_x, min_y, max_x, max_y, [&]( const unsigned index ) {
+            const unsigned x = snapshot.remembered_robots[ index ].first;
+            const unsigned y = snapshot.remembered_robots[ index ].second;
+            if( x < min_x || y < min_y || x >= max_x || y >= max_y )
+                return;
+
+            if( is_visible( x, y ) && m_obstacle_map.at( x, y ) != ObstacleType::Robot )
+                draw_robot( x, y, nullptr );
+        });
+    }
+
+    /* TODO: If two or more goals are set to the same title draw multiple ids. */
+    snapshot.goal_grid.for_each_near( min_x, min_y, max_x, max_y, [&]( const unsigned index ) {
+        const RobotSnapshot& robot = snapshot.robots[ index ];
+        unsigned goal_x = robot.goal_x;
+        unsigned goal_y = robot.goal_y;
 
-        unsigned goal_x = robot.goal_x();
-        unsigned goal_y = robot.goal_y();
+        if( !world_rect.intersects( block_rect( goal_x, goal_y ) ) )
+            return;
 
         ctx.setPen( QPen( Qt::red ) );
         ctx.setBrush( Qt::NoBrush );
         ctx.drawRect( QRect( goal_x * m_block_size + 1, goal_y * m_block_size + 1, m_block_size - 2, m_block_size - 2 ) );
 
-        if( m_selected_robot && !m_selected_robot->can_see( goal_x, goal_y ) )
-            ctx.setPen( QPen( Qt::white ) );
-        else
-            ctx.setPen( QPen( Qt::black ) );
-        ctx.drawText( goal_x * m_block_size + 2, goal_y * m_block_size, m_block_size / 2, m_block_size / 2, 0, QString::number( robot.id() ) );
-    }
+        const bool is_unknown = show_selected_robot && !can_see( goal_x, goal_y );
+        const QPixmap * id = label( robot.id, true, is_unknown ? qRgb( 0xff, 0xff, 0xff ) : qRgb( 0x00, 0x00, 0x00 ) );
+        if( id != nullptr )
+            ctx.drawPixmap( QPointF( goal_x * m_block_size + 2, goal_y * m_block_size ), *id );
+    });
 
 }
 
@@ -198,10 +624,10 @@ void SceneWidget::handle_mouse_interaction( QPoint mouse_position, Qt::MouseButt
     unsigned x = position.x() / m_block_size;
     unsigned y = position.y() / m_block_size;
 
-    if( x >= m_scene->width() || y >= m_scene->height() )
+    if( x >= m_obstacle_map.width() || y >= m_obstacle_map.height() )
         return;
 
-    Robot * robot = m_scene->get_robot( x, y );
+    const RobotSnapshot * robot = find_robot( x, y );
 
     bool action;
     if( buttons == Qt::LeftButton )
@@ -211,60 +637,71 @@ void SceneWidget::handle_mouse_interaction( QPoint mouse_position, Qt::MouseButt
     else
         return;
 
+    /*
+     * The edits are carried out by the simulation thread, and
+     * show up here once it has published the next snapshot.
+     */
     if( m_interaction_mode == InteractionMode::None ||
         (m_interaction_mode == InteractionMode::SetGoal && robot != nullptr ) )
     {
         if( is_mouse_move || buttons != Qt::LeftButton || robot == nullptr )
             return;
 
-        if( m_selected_robot == robot )
-            m_selected_robot = nullptr;
+        if( m_has_selected_robot && m_selected_robot_id == robot->id )
+        {
+            m_has_selected_robot = false;
+            post( SceneCommand{ SceneCommand::Type::DeselectRobot, x, y, false, 0, std::string() } );
+        }
         else
-            m_selected_robot = robot;
+        {
+            m_has_selected_robot = true;
+            m_selected_robot_id = robot->id;
+            post( SceneCommand{ SceneCommand::Type::SelectRobot, x, y, false, robot->id, std::string() } );
+        }
     }
     else if( m_interaction_mode == InteractionMode::ModifyWalls )
     {
-        if( m_scene->is_blocked( x, y ) == action )
+        if( (m_obstacle_map.at( x, y ) != ObstacleType::None) == action )
             return;
 
-        m_scene->set_wall( x, y, action );
+        post( SceneCommand{ SceneCommand::Type::SetWall, x, y, action, 0, std::string() } );
     }
     else if( m_interaction_mode == InteractionMode::SetRobot && !is_mouse_move )
     {
         if( action )
         {
-            m_scene->add_robot( x, y );
-            /*
-                m_selected_robot = ...
-            */
+            post( SceneCommand{ SceneCommand::Type::AddRobot, x, y, false, 0, std::string() } );
         }
         else
         {
             if( robot != nullptr )
             {
-                m_scene->remove_robot( *robot );
+                post( SceneCommand{ SceneCommand::Type::RemoveRobot, x, y, false, robot->id, std::string() } );
 
-                if( robot == m_selected_robot )
-                    m_selected_robot = nullptr;
+                if( m_has_selected_robot && m_selected_robot_id == robot->id )
+                {
+                    m_has_selected_robot = false;
+                    m_is_static_layer_valid = false;
+                }
             }
         }
     }
     else if( m_interaction_mode == InteractionMode::SetGoal && !is_mouse_move && !robot )
     {
-        if( m_selected_robot == nullptr )
+        if( !m_has_selected_robot )
             return;
 
-        m_selected_robot->set_goal( x, y );
-
+        post( SceneCommand{ SceneCommand::Type::SetGoal, x, y, false, m_selected_robot_id, std::string() } );
     }
     else
         return;
 
-    if( m_selected_robot != nullptr )
-        m_selected_robot->calculate_visibility();
-
-    /* TODO: Only modified cell should be repainted. */
-    repaint();
+    /* Only the selection is shown right away; the edits show up with the next snapshot. */
+    if( m_interaction_mode == InteractionMode::None || m_interaction_mode == InteractionMode::SetGoal )
+    {
+        m_is_static_layer_valid = false;
+        update();
+    }
 }
 
 void SceneWidget::mouseMoveEvent( QMouseEvent * event )
@@ -275,7 +712,7 @@ void SceneWidget::mouseMoveEvent( QMouseEvent * event )
 
         m_translation += QPointF(difference.x() / m_scale_factor.x(), difference.y() / m_scale_factor.y());
         m_last_mouse_position = event->pos();
-        repaint();
+        update();
     }
 
     handle_mouse_interaction( event->pos(), event->buttons(), true );
@@ -316,5 +753,5 @@ void SceneWidget::wheelEvent( QWheelEvent * event )
     m_scale_factor *= factor;
     m_translation += QPointF( bx, by );
 
-    repaint();
+    update();
 }
@@ -2,10 +2,20 @@
 #define SCENEWIDGET_H
 
 #include <QWidget>
+#include <QImage>
+#include <QPixmap>
+#include <QCache>
 #include <memory>
+#include <functional>
+#include <vector>
 
-class Scene;
-class Robot;
+#include "array2d.h"
+#include "scene.h"
+#include "rendersnapshot.h"
+#include "occupancypyramid.h"
+
+struct SceneCommand;
+class QPainter;
 
 class SceneWidget : public QWidget
 {
@@ -17,12 +27,58 @@ class SceneWidget : public QWidget
     QPointF m_scale_factor;
     QPointF m_translation;
 
-    Robot * m_selected_robot;
-
-    std::shared_ptr< Scene > m_scene;
+    bool m_has_selected_robot;
+    unsigned m_selected_robot_id;
+
+    /* The latest snapshot, and our own copy of the obstacle map kept up to date with it. */
+    const RenderSnapshot * m_snapshot;
+    Array2d< ObstacleType > m_obstacle_map;
+
+    /* What was drawn from the previous snapshot, to know what has to be redrawn. */
+    std::vector< RobotSnapshot > m_previous_robots;
+    bool m_previous_show_selected_robot;
+    QRect m_previous_selected_view;
+
+    /* How many walls there are in every area of m_obstacle_map. */
+    OccupancyPyramid m_wall_pyramid;
+
+    /*
+     * The grid, the walls and what the selected robot knows, drawn ahead
+     * of time with m_layer_block_size pixels per block and patched as
+     * the scene changes. Maps too big for that get one pixel per area
+     * of m_layer_level of the wall pyramid instead, shaded by how many
+     * walls it has; m_layer_level is negative otherwise.
+     */
+    QImage m_static_layer;
+    unsigned m_layer_block_size;
+    int m_layer_level;
+    bool m_is_static_layer_valid;
+
+    /* The ids drawn over the robots and the goals, keyed by id, kind and color. */
+    QCache< quint64, QPixmap > m_labels;
+
+    std::function< bool (const SceneCommand&) > m_command_handler;
+
+    const RobotSnapshot * find_robot( const unsigned x, const unsigned y ) const;
+    bool post( const SceneCommand& command );
+
+    bool shows_selected_robot() const;
+    QRectF robot_rect( const RobotSnapshot& robot ) const;
+    QRectF block_rect( const unsigned x, const unsigned y, const unsigned width = 1, const unsigned height = 1 ) const;
+    QRect to_screen_space( const QRectF& rect ) const;
+    QRect visible_blocks( const QRectF& world_rect ) const;
+
+    QRgb block_color( const unsigned x, const unsigned y, const bool show_selected_robot ) const;
+    void build_static_layer();
+    void paint_static_layer( unsigned min_x, unsigned min_y, unsigned max_x, unsigned max_y );
+    void paint_coarse_static_layer( unsigned min_x, unsigned min_y, unsigned max_x, unsigned max_y );
+    const QPixmap * label( const unsigned id, const bool is_goal, const QRgb color );
+    void paint_area( QPainter& ctx, const QRect& rect );
 
     public:
 
+        typedef std::function< bool (const SceneCommand&) > CommandHandler;
+
         enum class InteractionMode
         {
             None,
@@ -31,11 +87,23 @@ class SceneWidget : public QWidget
             SetGoal
         };
 
-        explicit SceneWidget( const std::shared_ptr< Scene > scene, QWidget * parent = nullptr );
+        explicit SceneWidget( QWidget * parent = nullptr );
         ~SceneWidget();
 
         void set_interaction_mode( InteractionMode mode );
 
+        /**
+         * @brief Sets the snapshot to draw; it has to stay valid until
+         *        the next call. The snapshots are expected to be given
+         *        in order, since only the changes between them are applied.
+         */
+        void set_snapshot( const RenderSnapshot& snapshot );
+
+        /**
+         * @brief Sets the function the edits made by the user are sent to.
+         */
+        void set_command_handler( const CommandHandler& handler );
+
     protected:
 
         virtual void paintEvent( QPaintEvent * event ) override;
@@ -2,11 +2,27 @@
 #include "scene.h"
 #include "robot.h"
 #include "routingalgorithm.h"
+#include "threadpool.h"
 
 #include <math.h>
+#include <limits>
+#include <algorithm>
+#include <assert.h>
+
+static const float robot_speed = 1.0f;
+
+/* Longest tick in which a robot still can't cross more than one block. */
+static const float max_tick = 0.5f / robot_speed;
+
+const std::size_t Simulation::robots_per_chunk;
 
 Simulation::Simulation( const std::shared_ptr< Scene >& scene ) :
-    m_scene( scene )
+    m_scene( scene ),
+    m_thread_pool( new ThreadPool() ),
+    m_timestep( 0.01f ),
+    m_accumulated_time( 0.0 ),
+    m_planning_budget( RoutingAlgorithm::unlimited_budget ),
+    m_planning_share( RoutingAlgorithm::unlimited_budget )
 {
 }
 
@@ -14,43 +30,226 @@ Simulation::~Simulation()
 {
 }
 
-void Simulation::run( const float elapsed )
+void Simulation::group_robots()
+{
+    const RobotStates& robots = m_scene->robot_states();
+    for( RoutingGroup& group: m_groups )
+        group.index.clear();
+
+    m_serial.clear();
+
+    for( std::size_t i = 0; i < robots.size(); ++i )
+    {
+        if( !robots.active[ i ] )
+        {
+            m_angles[ i ] = std::numeric_limits< float >::quiet_NaN();
+            continue;
+        }
+
+        RoutingAlgorithm * algorithm = robots.algorithm[ i ];
+        if( !algorithm->is_parallel_safe() )
+        {
+            m_serial.push_back( i );
+            continue;
+        }
+
+        /* There are hardly ever more than a few types, so they're just looked through. */
+        const std::type_info& type = typeid( *algorithm );
+        auto group = std::find_if( m_groups.begin(), m_groups.end(), [&type]( const RoutingGroup& group ) {
+            return *group.type == type;
+        });
+
+        if( group == m_groups.end() )
+        {
+            m_groups.emplace_back();
+            group = m_groups.end() - 1;
+            group->type = &type;
+        }
+
+        group->index.push_back( i );
+    }
+}
+
+/*
+ * When every robot of the group is next to each other, which is the
+ * case when all of them use the same algorithm, the batch is taken
+ * straight out of the scene's arrays; otherwise it's gathered first,
+ * and the angles are put back in place afterwards.
+ */
+void Simulation::decide( RoutingGroup& group, const float elapsed )
+{
+    const RobotStates& robots = m_scene->robot_states();
+    const std::size_t count = group.index.size();
+    const std::size_t first = group.index.front();
+    const bool is_side_by_side = group.index.back() - first + 1 == count;
+
+    RoutingBatch batch;
+    batch.size = count;
+    batch.planning_budget = m_planning_share;
+    if( is_side_by_side )
+    {
+        batch.robot = robots.robot.data() + first;
+        batch.algorithm = robots.algorithm.data() + first;
+        batch.x = robots.x.data() + first;
+        batch.y = robots.y.data() + first;
+        batch.frac_x = robots.frac_x.data() + first;
+        batch.frac_y = robots.frac_y.data() + first;
+        batch.goal_x = robots.goal_x.data() + first;
+        batch.goal_y = robots.goal_y.data() + first;
+        batch.angle = m_angles.data() + first;
+    }
+    else
+    {
+        group.robot.resize( count );
+        group.algorithm.resize( count );
+        group.x.resize( count );
+        group.y.resize( count );
+        group.frac_x.resize( count );
+        group.frac_y.resize( count );
+        group.goal_x.resize( count );
+        group.goal_y.resize( count );
+        group.angle.resize( count );
+
+        for( std::size_t i = 0; i < count; ++i )
+        {
+            const std::size_t index = group.index[ i ];
+            group.robot[ i ] = robots.robot[ index ];
+            group.algorithm[ i ] = robots.algorithm[ index ];
+            group.x[ i ] = robots.x[ index ];
+            group.y[ i ] = robots.y[ index ];
+            group.frac_x[ i ] = robots.frac_x[ index ];
+            group.frac_y[ i ] = robots.frac_y[ index ];
+            group.goal_x[ i ] = robots.goal_x[ index ];
+            group.goal_y[ i ] = robots.goal_y[ index ];
+        }
+
+        batch.robot = group.robot.data();
+        batch.algorithm = group.algorithm.data();
+        batch.x = group.x.data();
+        batch.y = group.y.data();
+        batch.frac_x = group.frac_x.data();
+        batch.frac_y = group.frac_y.data();
+        batch.goal_x = group.goal_x.data();
+        batch.goal_y = group.goal_y.data();
+        batch.angle = group.angle.data();
+    }
+
+    m_thread_pool->parallel_for( count, robots_per_chunk, [&]( const std::size_t begin, const std::size_t end ) {
+        batch.algorithm[ begin ]->run_batch( batch.slice( begin, end ), elapsed );
+
+        /* Whatever the robots learn from here on is new to the next run. */
+        for( std::size_t i = begin; i < end; ++i )
+            robots.robot[ group.index[ i ] ]->clear_knowledge_changes();
+    });
+
+    if( !is_side_by_side )
+    {
+        for( std::size_t i = 0; i < count; ++i )
+            m_angles[ group.index[ i ] ] = group.angle[ i ];
+    }
+}
+
+void Simulation::decide_serially( const float elapsed )
+{
+    const RobotStates& robots = m_scene->robot_states();
+    for( const std::size_t index: m_serial )
+    {
+        robots.algorithm[ index ]->set_planning_budget( m_planning_share );
+        m_angles[ index ] = robots.algorithm[ index ]->run( *robots.robot[ index ], elapsed );
+        robots.robot[ index ]->clear_knowledge_changes();
+    }
+}
+
+/*
+ * The robots which are done planning, by far the most, hardly use any of
+ * their share, so the searches which do need more than theirs get what's
+ * left over within the same tick. It's worked out from what every robot
+ * has spent, in their order, so the result doesn't depend on the number
+ * of threads.
+ */
+void Simulation::share_unspent_budget( const float elapsed )
 {
-    const float speed = 1.0f;
-    bool moved = false;
+    if( m_planning_budget == RoutingAlgorithm::unlimited_budget )
+        return;
 
-    for( Robot& robot: m_scene->robot_list() )
+    const RobotStates& robots = m_scene->robot_states();
+    std::size_t spent = 0;
+    m_searching.clear();
+    for( std::size_t i = 0; i < robots.size(); ++i )
     {
-        if( !robot.has_goal() )
+        if( !robots.active[ i ] )
             continue;
 
-        RoutingAlgorithm * algorithm = robot.routing_algorithm();
-        if( algorithm == nullptr )
+        spent += robots.algorithm[ i ]->planning_spent();
+        if( robots.algorithm[ i ]->is_out_of_budget() )
+            m_searching.push_back( i );
+    }
+
+    if( m_searching.empty() || spent >= m_planning_budget )
+        return;
+
+    const std::size_t share = (m_planning_budget - spent) / m_searching.size();
+    if( share == 0 )
+        return;
+
+    m_thread_pool->parallel_for( m_searching.size(), robots_per_chunk, [&]( const std::size_t begin, const std::size_t end ) {
+        for( std::size_t i = begin; i < end; ++i )
+        {
+            const std::size_t index = m_searching[ i ];
+            if( !robots.algorithm[ index ]->is_parallel_safe() )
+                continue;
+
+            robots.algorithm[ index ]->set_planning_budget( share );
+            m_angles[ index ] = robots.algorithm[ index ]->run( *robots.robot[ index ], elapsed );
+        }
+    });
+
+    for( const std::size_t index: m_searching )
+    {
+        if( robots.algorithm[ index ]->is_parallel_safe() )
             continue;
 
-        const float angle = algorithm->run( robot, elapsed );
+        robots.algorithm[ index ]->set_planning_budget( share );
+        m_angles[ index ] = robots.algorithm[ index ]->run( *robots.robot[ index ], elapsed );
+    }
+}
+
+void Simulation::commit( const float elapsed )
+{
+    RobotStates& robots = m_scene->robot_states();
+    const unsigned width = m_scene->width();
+    const unsigned height = m_scene->height();
+
+    for( std::size_t i = 0; i < robots.size(); ++i )
+    {
+        const float angle = m_angles[ i ];
         if( isnan( angle ) )
             continue;
 
-        const float dx = cosf( angle ) * elapsed * speed;
-        const float dy = sinf( angle ) * elapsed * speed;
+        Robot& robot = *robots.robot[ i ];
+
+        const float dx = cosf( angle ) * elapsed * robot_speed;
+        const float dy = sinf( angle ) * elapsed * robot_speed;
 
-        robot.calculate_visibility();
+        const unsigned x = robots.x[ i ];
+        const unsigned y = robots.y[ i ];
+        float& frac_x = robots.frac_x[ i ];
+        float& frac_y = robots.frac_y[ i ];
 
-        if( robot.x() == robot.goal_x() && robot.y() == robot.goal_y() )
+        if( x == robots.goal_x[ i ] && y == robots.goal_y[ i ] )
         {
-            bool x_done = fabsf( robot.frac_x() - 0.5 ) <= dx;
-            bool y_done = fabsf( robot.frac_y() - 0.5 ) <= dy;
+            bool x_done = fabsf( frac_x - 0.5 ) <= dx;
+            bool y_done = fabsf( frac_y - 0.5 ) <= dy;
 
             if( x_done )
-                robot.m_frac_x = 0.5;
+                frac_x = 0.5;
             else
-                robot.m_frac_x += dx;
+                frac_x += dx;
 
             if( y_done )
-                robot.m_frac_y = 0.5;
+                frac_y = 0.5;
             else
-                robot.m_frac_y += dy;
+                frac_y += dy;
 
             if( x_done && y_done )
             {
@@ -60,62 +259,162 @@ void Simulation::run( const float elapsed )
         }
         else
         {
-            robot.m_frac_x += dx;
-            robot.m_frac_y += dy;
+            frac_x += dx;
+            frac_y += dy;
         }
 
-        if( robot.frac_x() >= 1.0f )
+        if( frac_x >= 1.0f )
         {
-            if( robot.x() == (m_scene->width() - 1) || m_scene->is_blocked( robot.x() + 1, robot.y() ) )
-                robot.m_frac_x = 0.99f;
+            if( x == (width - 1) || m_scene->is_blocked( x + 1, y ) )
+                frac_x = 0.99f;
             else
             {
-                robot.m_frac_x = 0.0f;
-                robot.move_to( robot.x() + 1, robot.y() );
-                moved = true;
+                frac_x = 0.0f;
+                robot.move_to( x + 1, y );
             }
         }
-        else if( robot.frac_x() < 0.0f )
+        else if( frac_x < 0.0f )
         {
-            if( robot.x() == 0 || m_scene->is_blocked( robot.x() - 1, robot.y() ) )
-                robot.m_frac_x = 0.0f;
+            if( x == 0 || m_scene->is_blocked( x - 1, y ) )
+                frac_x = 0.0f;
             else
             {
-                robot.m_frac_x = 0.99f;
-                robot.move_to( robot.x() - 1, robot.y() );
-                moved = true;
+                frac_x = 0.99f;
+                robot.move_to( x - 1, y );
             }
         }
 
-        if( robot.frac_y() >= 1.0f )
+        /* The robot might have moved horizontally. */
+        const unsigned new_x = robots.x[ i ];
+
+        if( frac_y >= 1.0f )
         {
-            if( robot.y() == (m_scene->height() - 1) || m_scene->is_blocked( robot.x(), robot.y() + 1 ) )
-                robot.m_frac_y = 0.99f;
+            if( y == (height - 1) || m_scene->is_blocked( new_x, y + 1 ) )
+                frac_y = 0.99f;
             else
             {
-                robot.m_frac_y = 0.0f;
-                robot.move_to( robot.x(), robot.y() + 1 );
-                moved = true;
+                frac_y = 0.0f;
+                robot.move_to( new_x, y + 1 );
             }
         }
-        else if( robot.frac_y() < 0.0f )
+        else if( frac_y < 0.0f )
         {
-            if( robot.y() == 0 || m_scene->is_blocked( robot.x(), robot.y() - 1 ) )
-                robot.m_frac_y = 0.0f;
+            if( y == 0 || m_scene->is_blocked( new_x, y - 1 ) )
+                frac_y = 0.0f;
             else
             {
-                robot.m_frac_y = 0.99f;
-                robot.move_to( robot.x(), robot.y() - 1 );
-                moved = true;
+                frac_y = 0.99f;
+                robot.move_to( new_x, y - 1 );
             }
         }
     }
+}
+
+/*
+ * The routing algorithms only read the scene, and each one only
+ * writes to its own state, so they can all run at the same time;
+ * the few which also write to the reservation table run after.
+ */
+void Simulation::decide_all( const float elapsed )
+{
+    group_robots();
+
+    std::size_t active_count = m_serial.size();
+    for( const RoutingGroup& group: m_groups )
+        active_count += group.index.size();
+
+    m_planning_share = m_planning_budget;
+    if( m_planning_budget != RoutingAlgorithm::unlimited_budget && active_count > 0 )
+        m_planning_share = std::max< std::size_t >( m_planning_budget / active_count, 1 );
+    for( RoutingGroup& group: m_groups )
+    {
+        if( !group.index.empty() )
+            decide( group, elapsed );
+    }
 
-    if( moved )
+    decide_serially( elapsed );
+    share_unspent_budget( elapsed );
+}
+
+void Simulation::tick( const float elapsed )
+{
+    m_angles.resize( m_scene->robot_states().size() );
+
+    decide_all( elapsed );
+    commit( elapsed );
+    m_scene->reservation_table().advance( elapsed * robot_speed );
+    m_scene->update_visibility( m_thread_pool.get() );
+}
+
+void Simulation::run( const float elapsed )
+{
+    if( elapsed <= max_tick )
     {
-        for( Robot& robot: m_scene->robot_list() )
-            robot.calculate_visibility();
+        tick( elapsed );
+        return;
     }
+
+    const unsigned ticks = (unsigned)ceilf( elapsed / max_tick );
+    for( unsigned i = 0; i < ticks; ++i )
+        tick( elapsed / ticks );
+}
+
+float Simulation::timestep() const
+{
+    return m_timestep;
+}
+
+void Simulation::set_timestep( const float timestep )
+{
+    assert( timestep > 0.0f );
+    m_timestep = timestep;
+}
+
+void Simulation::step()
+{
+    run( m_timestep );
+}
+
+void Simulation::accumulate( const float elapsed )
+{
+    m_accumulated_time += elapsed;
+}
+
+bool Simulation::step_accumulated()
+{
+    if( m_accumulated_time < m_timestep )
+        return false;
+
+    m_accumulated_time -= m_timestep;
+    step();
+
+    return true;
+}
+
+void Simulation::discard_accumulated()
+{
+    m_accumulated_time = 0.0;
+}
+
+unsigned Simulation::thread_count() const
+{
+    return m_thread_pool->thread_count();
+}
+
+void Simulation::set_thread_count( const unsigned count )
+{
+    m_thread_pool.reset();
+    m_thread_pool.reset( new ThreadPool( count ) );
+}
+
+std::size_t Simulation::planning_budget() const
+{
+    return m_planning_budget;
+}
+
+void Simulation::set_planning_budget( const std::size_t budget )
+{
+    m_planning_budget = budget;
 }
 
 const std::shared_ptr< Scene >& Simulation::scene() const
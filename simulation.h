@@ -2,9 +2,13 @@
 #define SIMULATION_H
 
 #include <memory>
+#include <vector>
+#include <typeinfo>
 
 class Scene;
 class Robot;
+class RoutingAlgorithm;
+class ThreadPool;
 
 class Simulation
 {
@@ -12,14 +16,154 @@ class Simulation
     void operator =( const Simulation& ) = delete;
     void operator =( Simulation&& ) = delete;
 
-    std::shared_ptr< Scene > m_scene;
+    protected:
+        /* Number of robots a thread takes from the pool at once. */
+        static const std::size_t robots_per_chunk = 64;
+
+        std::shared_ptr< Scene > m_scene;
+        std::unique_ptr< ThreadPool > m_thread_pool;
+
+        /* Direction picked by every robot in the current tick; NaN if none. */
+        std::vector< float > m_angles;
+
+        /**
+         * @brief Fills m_angles, already as big as there are robots, with
+         *        the direction every robot picks; the first phase of a tick.
+         */
+        virtual void decide_all( const float elapsed );
+
+    private:
+        /*
+         * The active robots whose algorithms are parallel safe, grouped by
+         * the algorithms' type, so that each type can steer all of its
+         * robots in a single call; rebuilt every tick.
+         */
+        struct RoutingGroup
+        {
+            const std::type_info * type;
+            std::vector< std::size_t > index;
+
+            /* Their states, gathered; only when they aren't already side by side in Scene::robot_states(). */
+            std::vector< const Robot * > robot;
+            std::vector< RoutingAlgorithm * > algorithm;
+            std::vector< unsigned > x, y, goal_x, goal_y;
+            std::vector< float > frac_x, frac_y, angle;
+        };
+
+        std::vector< RoutingGroup > m_groups;
+
+        /* The active robots whose algorithms aren't parallel safe, in order. */
+        std::vector< std::size_t > m_serial;
+
+        float m_timestep;
+        double m_accumulated_time;
+
+        /* Planning budget of the whole tick, and what each robot gets of it in the current one. */
+        std::size_t m_planning_budget;
+        std::size_t m_planning_share;
+
+        /* The robots whose searches ran out of their share in the current tick, in order. */
+        std::vector< std::size_t > m_searching;
+
+        void group_robots();
+        void decide( RoutingGroup& group, const float elapsed );
+        void decide_serially( const float elapsed );
+        void share_unspent_budget( const float elapsed );
+        void commit( const float elapsed );
+        void tick( const float elapsed );
 
     public:
         explicit Simulation( const std::shared_ptr< Scene >& scene );
-        ~Simulation();
+        virtual ~Simulation();
 
+        /**
+         * @brief Advances the simulation by @a elapsed seconds.
+         *
+         * Long periods are split into several ticks, short enough
+         * that no robot can cross more than one block in a single one.
+         * Every tick is split into two phases. First the routing
+         * algorithms of all robots pick their directions in parallel,
+         * all looking at the scene as it was at the start of the tick,
+         * with the robots whose algorithms are of the same type passed
+         * to it together, see RoutingAlgorithm::run_batch();
+         * the algorithms which aren't safe to run in parallel pick
+         * theirs after that, one by one in the order of the robots.
+         * Then the robots are moved one by one in the order of
+         * Scene::robot_states(), so when two robots want the same block
+         * the earlier one gets it. The result doesn't depend on the
+         * number of threads.
+         */
         void run( const float elapsed );
 
+        /**
+         * @return Length of a fixed step, in seconds.
+         */
+        float timestep() const;
+
+        /**
+         * @brief Sets the length of a fixed step, in seconds.
+         */
+        void set_timestep( const float timestep );
+
+        /**
+         * @brief Advances the simulation by one fixed step.
+         */
+        void step();
+
+        /**
+         * @brief Adds @a elapsed seconds to the time which
+         *        is still to be simulated in fixed steps.
+         */
+        void accumulate( const float elapsed );
+
+        /**
+         * @brief Runs one fixed step if at least that much
+         *        time has been accumulated.
+         * @return Whenever a step was run.
+         */
+        bool step_accumulated();
+
+        /**
+         * @brief Drops the accumulated time; useful when
+         *        the simulation can't keep up with it.
+         */
+        void discard_accumulated();
+
+        /**
+         * @return Number of threads used to run the routing
+         *         algorithms and to update the robots' visibility.
+         */
+        unsigned thread_count() const;
+
+        /**
+         * @brief Sets the number of threads used to run the routing
+         *        algorithms and to update the robots' visibility; zero
+         *        uses every hardware thread and one runs everything
+         *        on the calling thread.
+         */
+        void set_thread_count( const unsigned count );
+
+        /**
+         * @return Most nodes the robots' searches may go through in
+         *         a single tick, all together; see set_planning_budget().
+         */
+        std::size_t planning_budget() const;
+
+        /**
+         * @brief Sets most nodes the robots' searches may go through in
+         *        a single tick, all together, which bounds how long a
+         *        tick takes no matter how hard the robots' routes are to
+         *        find; RoutingAlgorithm::unlimited_budget, the default,
+         *        lifts the limit.
+         *
+         * Every active robot gets an equal share of it, but at least one
+         * node, so that every search makes some progress. Whatever the
+         * robots don't use is then split between the ones whose searches
+         * ran out, which are run once more with it; those which run out
+         * again carry on with their searches in the next ticks.
+         */
+        void set_planning_budget( const std::size_t budget );
+
         const std::shared_ptr< Scene >& scene() const;
         std::shared_ptr< Scene >& scene();
 };
@@ -0,0 +1,259 @@
+#include "simulationthread.h"
+#include "simulation.h"
+#include "scene.h"
+#include "robot.h"
+#include "routingalgorithm.h"
+#include "routingalgorithmregistry.h"
+
+#include <assert.h>
+
+/* How long the simulation may run before checking for commands again. */
+static const std::chrono::milliseconds step_budget( 4 );
+
+/* Snapshots are published at most this often while the simulation runs. */
+static const std::chrono::milliseconds publish_interval( 8 );
+
+/* How long to sleep when there's nothing to do. */
+static const std::chrono::milliseconds idle_interval( 1 );
+
+SimulationThread::SimulationThread( std::unique_ptr< Simulation > simulation ) :
+    m_simulation( std::move( simulation ) ),
+    m_quit( false ),
+    m_speed_multiplier( 1 ),
+    m_commands( 4096 ),
+    m_running( false ),
+    m_has_selected_robot( false ),
+    m_selected_robot_id( 0 ),
+    m_back_snapshot_seen( true )
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+Simulation& SimulationThread::simulation()
+{
+    assert( !m_thread.joinable() );
+    return *m_simulation;
+}
+
+void SimulationThread::start()
+{
+    if( m_thread.joinable() )
+        return;
+
+    m_quit = false;
+    m_thread = std::thread( &SimulationThread::thread_main, this );
+}
+
+void SimulationThread::stop()
+{
+    if( !m_thread.joinable() )
+        return;
+
+    m_quit = true;
+    m_thread.join();
+}
+
+bool SimulationThread::post( const SceneCommand& command )
+{
+    return m_commands.push( command );
+}
+
+void SimulationThread::set_speed_multiplier( const int multiplier )
+{
+    m_speed_multiplier = multiplier;
+}
+
+bool SimulationThread::update_snapshot()
+{
+    return m_snapshots.acquire();
+}
+
+const RenderSnapshot& SimulationThread::snapshot() const
+{
+    return m_snapshots.front();
+}
+
+Robot * SimulationThread::find_robot( const unsigned id )
+{
+    const RobotStates& states = m_simulation->scene()->robot_states();
+    for( std::size_t i = 0; i < states.size(); ++i )
+    {
+        if( states.id[ i ] == id )
+            return states.robot[ i ];
+    }
+
+    return nullptr;
+}
+
+bool SimulationThread::execute( const SceneCommand& command )
+{
+    Scene& scene = *m_simulation->scene();
+
+    const bool in_bounds = command.x < scene.width() && command.y < scene.height();
+    switch( command.type )
+    {
+        case SceneCommand::Type::SetWall:
+        {
+            if( !in_bounds || scene.is_blocked( command.x, command.y ) == command.value )
+                return false;
+
+            scene.set_wall( command.x, command.y, command.value );
+            break;
+        }
+
+        case SceneCommand::Type::AddRobot:
+        {
+            if( !in_bounds )
+                return false;
+
+            scene.add_robot( command.x, command.y );
+            break;
+        }
+
+        case SceneCommand::Type::RemoveRobot:
+        {
+            Robot * robot = find_robot( command.robot_id );
+            if( robot == nullptr )
+                return false;
+
+            scene.remove_robot( *robot );
+            break;
+        }
+
+        case SceneCommand::Type::SetGoal:
+        {
+            Robot * robot = find_robot( command.robot_id );
+            if( robot == nullptr || !in_bounds )
+                return false;
+
+            robot->set_goal( command.x, command.y );
+            break;
+        }
+
+        case SceneCommand::Type::SelectRobot:
+        {
+            m_has_selected_robot = true;
+            m_selected_robot_id = command.robot_id;
+            break;
+        }
+
+        case SceneCommand::Type::DeselectRobot:
+        {
+            m_has_selected_robot = false;
+            break;
+        }
+
+        case SceneCommand::Type::StartSimulation:
+        {
+            for( Robot& robot: scene.robot_list() )
+            {
+                auto algorithm = RoutingAlgorithmRegistry::instance().instantiate_algorithm( command.algorithm );
+                assert( algorithm.get() != nullptr );
+
+                robot.set_routing_algorithm( std::move( algorithm ) );
+            }
+
+            m_simulation->discard_accumulated();
+            m_running = true;
+            break;
+        }
+
+        case SceneCommand::Type::StopSimulation:
+        {
+            m_running = false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Runs the simulation for as many fixed steps as @a elapsed real seconds
+ * call for; returns whenever any step was run.
+ */
+bool SimulationThread::advance( const double elapsed )
+{
+    const Clock::time_point deadline = Clock::now() + step_budget;
+    const int multiplier = m_speed_multiplier;
+
+    if( multiplier == 0 )
+    {
+        do
+        {
+            m_simulation->step();
+        }
+        while( Clock::now() < deadline );
+
+        return true;
+    }
+
+    bool stepped = false;
+    m_simulation->accumulate( elapsed * multiplier );
+    while( m_simulation->step_accumulated() )
+    {
+        stepped = true;
+
+        /* Rather slow down than fall further and further behind. */
+        if( Clock::now() >= deadline )
+        {
+            m_simulation->discard_accumulated();
+            break;
+        }
+    }
+
+    return stepped;
+}
+
+void SimulationThread::publish_snapshot()
+{
+    Robot * selected_robot = m_has_selected_robot ? find_robot( m_selected_robot_id ) : nullptr;
+    if( m_has_selected_robot && selected_robot == nullptr )
+        m_has_selected_robot = false;
+
+    m_snapshots.back().capture( *m_simulation->scene(), selected_robot, !m_back_snapshot_seen );
+    m_back_snapshot_seen = m_snapshots.publish();
+    m_last_publish = Clock::now();
+}
+
+void SimulationThread::thread_main()
+{
+    Clock::time_point last_step = Clock::now();
+    bool dirty = true;
+
+    /* The scene might have just been loaded. */
+    m_simulation->scene()->update_visibility();
+
+    while( !m_quit )
+    {
+        bool executed = false;
+
+        SceneCommand command;
+        while( m_commands.pop( command ) )
+            executed = execute( command ) || executed;
+
+        if( executed )
+            m_simulation->scene()->update_visibility();
+
+        const Clock::time_point now = Clock::now();
+        const double elapsed = std::chrono::duration< double >( now - last_step ).count();
+        last_step = now;
+
+        const bool stepped = m_running && advance( elapsed );
+        dirty = dirty || executed || stepped;
+
+        /* Edits are shown right away, the simulation itself at a steady rate. */
+        if( dirty && (executed || Clock::now() - m_last_publish >= publish_interval) )
+        {
+            publish_snapshot();
+            dirty = false;
+        }
+
+        if( !executed && !stepped )
+            std::this_thread::sleep_for( idle_interval );
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "spscqueue.h"
+#include "triplebuffer.h"
+#include "rendersnapshot.h"
+
+class Simulation;
+class Robot;
+
+/**
+ * @brief A change to the scene requested by the user interface.
+ */
+struct SceneCommand
+{
+    enum class Type
+    {
+        SetWall,
+        AddRobot,
+        RemoveRobot,
+        SetGoal,
+        SelectRobot,
+        DeselectRobot,
+        StartSimulation,
+        StopSimulation
+    };
+
+    Type type;
+
+    /* The block the command applies to. */
+    unsigned x, y;
+
+    /* Whenever SetWall should add or remove the wall. */
+    bool value;
+
+    /* The robot RemoveRobot, SetGoal and SelectRobot apply to. */
+    unsigned robot_id;
+
+    /* The routing algorithm StartSimulation assigns to every robot. */
+    std::string algorithm;
+};
+
+/**
+ * @brief Runs a Simulation on a thread of its own, so that neither
+ *        a slow tick nor a slow paint holds up the other.
+ *
+ * The user interface talks to the thread only through a lock-free
+ * command queue and gets back render snapshots through a triple buffer.
+ * While the thread isn't running the simulation can be used directly.
+ */
+class SimulationThread
+{
+    SimulationThread( const SimulationThread& ) = delete;
+    SimulationThread& operator =( const SimulationThread& ) = delete;
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::unique_ptr< Simulation > m_simulation;
+    std::thread m_thread;
+    std::atomic< bool > m_quit;
+    std::atomic< int > m_speed_multiplier;
+
+    SpscQueue< SceneCommand > m_commands;
+    TripleBuffer< RenderSnapshot > m_snapshots;
+
+    /* Only touched by the simulation thread while it's running. */
+    bool m_running;
+    bool m_has_selected_robot;
+    unsigned m_selected_robot_id;
+    bool m_back_snapshot_seen;
+    Clock::time_point m_last_publish;
+
+    void thread_main();
+    bool execute( const SceneCommand& command );
+    Robot * find_robot( const unsigned id );
+    bool advance( const double elapsed );
+    void publish_snapshot();
+
+    public:
+        explicit SimulationThread( std::unique_ptr< Simulation > simulation );
+        ~SimulationThread();
+
+        /**
+         * @return The simulation; only to be used while the thread isn't running.
+         */
+        Simulation& simulation();
+
+        /**
+         * @brief Starts the thread.
+         */
+        void start();
+
+        /**
+         * @brief Stops the thread and waits for it to finish.
+         */
+        void stop();
+
+        /**
+         * @brief Queues a command for the simulation thread.
+         * @return Whenever there was space for it in the queue.
+         */
+        bool post( const SceneCommand& command );
+
+        /**
+         * @brief Sets how many simulated seconds pass every real one;
+         *        zero runs the simulation as fast as possible.
+         */
+        void set_speed_multiplier( const int multiplier );
+
+        /**
+         * @brief Takes the latest snapshot published by the thread.
+         * @return Whenever there was a new one.
+         */
+        bool update_snapshot();
+
+        /**
+         * @return Snapshot taken by the last update_snapshot(); stays
+         *         valid until the next call.
+         */
+        const RenderSnapshot& snapshot() const;
+};
+
+#endif // SIMULATIONTHREAD_H
@@ -0,0 +1,94 @@
+#ifndef SPECIALIZEDSIMULATION_H
+#define SPECIALIZEDSIMULATION_H
+
+#include "simulation.h"
+#include "scene.h"
+#include "robot.h"
+#include "threadpool.h"
+
+#include <limits>
+#include <typeinfo>
+
+/**
+ * @brief A Simulation of robots which all use the same routing algorithm,
+ *        with its steering compiled straight into the loop over them
+ *        instead of being called through every robot's own instance.
+ *
+ * The @a Algorithm has to have a static steer() which picks a direction
+ * from nothing but a robot's position and goal, exactly like its run()
+ * does; see DummyAlgorithm. The rest of a tick is Simulation's own, so
+ * the results are the same.
+ *
+ * Only the algorithms which keep nothing at all per robot can be run
+ * this way; the ones which do, which are all of those which search for
+ * a path, have their own instance for every robot anyway, and are run
+ * through it by Simulation instead.
+ *
+ * Should any robot have some other algorithm, even one derived from
+ * @a Algorithm, the tick is left to Simulation altogether. Whenever it
+ * does is only looked at again once the robots or their algorithms
+ * change, not every tick.
+ */
+template< typename Algorithm >
+class SpecializedSimulation : public Simulation
+{
+    /* The robots last looked at, and whenever all of them use @a Algorithm. */
+    const RobotStates * m_checked_robots;
+    unsigned m_checked_version;
+    bool m_is_uniform;
+
+    bool is_uniform( const RobotStates& robots )
+    {
+        if( m_checked_robots == &robots && m_checked_version == robots.algorithm_version )
+            return m_is_uniform;
+
+        m_checked_robots = &robots;
+        m_checked_version = robots.algorithm_version;
+        m_is_uniform = true;
+        for( std::size_t i = 0; i < robots.size() && m_is_uniform; ++i )
+            m_is_uniform = !robots.algorithm[ i ] || typeid( *robots.algorithm[ i ] ) == typeid( Algorithm );
+
+        return m_is_uniform;
+    }
+
+    protected:
+        virtual void decide_all( const float elapsed ) override
+        {
+            const RobotStates& robots = m_scene->robot_states();
+            if( !is_uniform( robots ) )
+            {
+                Simulation::decide_all( elapsed );
+                return;
+            }
+
+            float * angles = m_angles.data();
+
+            m_thread_pool->parallel_for( robots.size(), robots_per_chunk, [&]( const std::size_t begin, const std::size_t end ) {
+                for( std::size_t i = begin; i < end; ++i )
+                {
+                    if( !robots.active[ i ] )
+                    {
+                        angles[ i ] = std::numeric_limits< float >::quiet_NaN();
+                        continue;
+                    }
+
+                    angles[ i ] = Algorithm::steer( robots.x[ i ], robots.y[ i ], robots.frac_x[ i ], robots.frac_y[ i ],
+                                                    robots.goal_x[ i ], robots.goal_y[ i ] );
+
+                    /* Whatever the robot learns from here on is new to the next run. */
+                    robots.robot[ i ]->clear_knowledge_changes();
+                }
+            });
+        }
+
+    public:
+        explicit SpecializedSimulation( const std::shared_ptr< Scene >& scene ) :
+            Simulation( scene ),
+            m_checked_robots( nullptr ),
+            m_checked_version( 0 ),
+            m_is_uniform( false )
+        {
+        }
+};
+
+#endif // SPECIALIZEDSIMULATION_H
@@ -0,0 +1,74 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <assert.h>
+
+/**
+ * @brief A bounded lock-free queue for passing values from
+ *        exactly one producer thread to exactly one consumer thread.
+ */
+template < typename type_t >
+class SpscQueue
+{
+    SpscQueue( const SpscQueue& ) = delete;
+    SpscQueue& operator =( const SpscQueue& ) = delete;
+
+    std::vector< type_t > m_slots;
+    std::size_t m_mask;
+
+    /* Kept on separate cache lines, since each one is written by a different thread. */
+    char m_padding_before_head[ 64 ];
+    std::atomic< std::size_t > m_head;
+    char m_padding_before_tail[ 64 ];
+    std::atomic< std::size_t > m_tail;
+
+    public:
+        /**
+         * @param capacity Maximum number of queued values; must be a power of two.
+         */
+        explicit SpscQueue( const std::size_t capacity ) :
+            m_slots( capacity ),
+            m_mask( capacity - 1 ),
+            m_head( 0 ),
+            m_tail( 0 )
+        {
+            assert( capacity > 0 && (capacity & (capacity - 1)) == 0 );
+        }
+
+        /**
+         * @brief Appends a value to the queue; producer only.
+         * @return Whenever there was space for it.
+         */
+        bool push( const type_t& value )
+        {
+            const std::size_t tail = m_tail.load( std::memory_order_relaxed );
+            if( tail - m_head.load( std::memory_order_acquire ) == m_slots.size() )
+                return false;
+
+            m_slots[ tail & m_mask ] = value;
+            m_tail.store( tail + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        /**
+         * @brief Takes the oldest value out of the queue; consumer only.
+         * @return Whenever the queue wasn't empty.
+         */
+        bool pop( type_t& o_value )
+        {
+            const std::size_t head = m_head.load( std::memory_order_relaxed );
+            if( head == m_tail.load( std::memory_order_acquire ) )
+                return false;
+
+            o_value = std::move( m_slots[ head & m_mask ] );
+            m_head.store( head + 1, std::memory_order_release );
+
+            return true;
+        }
+};
+
+#endif // SPSCQUEUE_H
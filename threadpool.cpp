@@ -0,0 +1,168 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <assert.h>
+
+static uint64_t pack_range( const uint64_t begin, const uint64_t end )
+{
+    return (begin << 32) | end;
+}
+
+static std::size_t range_begin( const uint64_t bounds )
+{
+    return bounds >> 32;
+}
+
+static std::size_t range_end( const uint64_t bounds )
+{
+    return bounds & 0xffffffff;
+}
+
+ThreadPool::ThreadPool( const unsigned thread_count ) :
+    m_job( nullptr ),
+    m_job_chunk( 1 ),
+    m_generation( 0 ),
+    m_running( 0 ),
+    m_quit( false )
+{
+    unsigned count = thread_count;
+    if( count == 0 )
+        count = std::max( std::thread::hardware_concurrency(), 1u );
+
+    m_ranges.reset( new WorkRange[ count ] );
+    for( unsigned i = 0; i < count; ++i )
+        m_ranges[ i ].bounds = 0;
+
+    for( unsigned i = 1; i < count; ++i )
+        m_workers.emplace_back( &ThreadPool::worker_main, this, i );
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_quit = true;
+    }
+
+    m_job_ready.notify_all();
+    for( std::thread& worker: m_workers )
+        worker.join();
+}
+
+unsigned ThreadPool::thread_count() const
+{
+    return m_workers.size() + 1;
+}
+
+/*
+ * Moves the back half of another thread's remaining range into this
+ * thread's own, where it can in turn be stolen from again.
+ */
+bool ThreadPool::steal( const unsigned thread_index )
+{
+    const unsigned count = thread_count();
+    for( unsigned offset = 1; offset < count; ++offset )
+    {
+        WorkRange& victim = m_ranges[ (thread_index + offset) % count ];
+
+        uint64_t bounds = victim.bounds.load();
+        for( ;; )
+        {
+            const std::size_t begin = range_begin( bounds );
+            const std::size_t end = range_end( bounds );
+            if( begin >= end )
+                break;
+
+            /* Leave the victim at least the chunk it's probably working on. */
+            const std::size_t split = end - begin > m_job_chunk ? begin + (end - begin) / 2 : begin;
+            if( victim.bounds.compare_exchange_weak( bounds, pack_range( begin, split ) ) )
+            {
+                m_ranges[ thread_index ].bounds = pack_range( split, end );
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::run_job( const unsigned thread_index )
+{
+    WorkRange& own = m_ranges[ thread_index ];
+    do
+    {
+        uint64_t bounds = own.bounds.load();
+        for( ;; )
+        {
+            const std::size_t begin = range_begin( bounds );
+            const std::size_t end = range_end( bounds );
+            if( begin >= end )
+                break;
+
+            const std::size_t chunk_end = std::min( begin + m_job_chunk, end );
+            if( !own.bounds.compare_exchange_weak( bounds, pack_range( chunk_end, end ) ) )
+                continue;
+
+            (*m_job)( begin, chunk_end );
+            bounds = own.bounds.load();
+        }
+    }
+    while( steal( thread_index ) );
+}
+
+void ThreadPool::worker_main( const unsigned thread_index )
+{
+    unsigned long long generation = 0;
+    for( ;; )
+    {
+        {
+            std::unique_lock< std::mutex > lock( m_mutex );
+            m_job_ready.wait( lock, [&]() { return m_quit || m_generation != generation; } );
+            if( m_quit )
+                return;
+
+            generation = m_generation;
+        }
+
+        run_job( thread_index );
+
+        {
+            std::lock_guard< std::mutex > lock( m_mutex );
+            if( --m_running == 0 )
+                m_job_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallel_for( const std::size_t count, const std::size_t chunk, const RangeFunction& function )
+{
+    if( count == 0 )
+        return;
+
+    if( m_workers.empty() || count <= chunk )
+    {
+        function( 0, count );
+        return;
+    }
+
+    assert( count <= 0xffffffff );
+
+    const unsigned threads = thread_count();
+
+    std::unique_lock< std::mutex > lock( m_mutex );
+    m_job = &function;
+    m_job_chunk = std::max( chunk, std::size_t( 1 ) );
+    for( unsigned i = 0; i < threads; ++i )
+        m_ranges[ i ].bounds = pack_range( count * i / threads, count * (i + 1) / threads );
+
+    m_running = m_workers.size();
+    m_generation++;
+    lock.unlock();
+
+    m_job_ready.notify_all();
+    run_job( 0 );
+
+    lock.lock();
+    m_job_done.wait( lock, [&]() { return m_running == 0; } );
+    m_job = nullptr;
+}
@@ -0,0 +1,84 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+/**
+ * @brief A fixed set of worker threads which split loops over
+ *        a range of indices between themselves and the caller.
+ *
+ * Every thread starts with an equal share of the range, which it
+ * works through in small chunks; a thread which runs out of work
+ * steals half of what is left from another one, so uneven
+ * per-index costs still keep every thread busy.
+ */
+class ThreadPool
+{
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator =( const ThreadPool& ) = delete;
+
+    typedef std::function< void (std::size_t, std::size_t) > RangeFunction;
+
+    /*
+     * The part of the range still owned by one thread, packed as
+     * (begin << 32) | end so that it can be updated atomically.
+     * Padded so that every thread's share lives in its own cache line.
+     */
+    struct WorkRange
+    {
+        std::atomic< uint64_t > bounds;
+        char padding[ 64 - sizeof( std::atomic< uint64_t > ) ];
+    };
+
+    std::vector< std::thread > m_workers;
+    std::unique_ptr< WorkRange[] > m_ranges;
+
+    std::mutex m_mutex;
+    std::condition_variable m_job_ready;
+    std::condition_variable m_job_done;
+
+    /* The job currently being run; only valid while m_running > 0. */
+    const RangeFunction * m_job;
+    std::size_t m_job_chunk;
+
+    unsigned long long m_generation;
+    unsigned m_running;
+    bool m_quit;
+
+    void worker_main( const unsigned thread_index );
+    void run_job( const unsigned thread_index );
+    bool steal( const unsigned thread_index );
+
+    public:
+        /**
+         * @param thread_count Number of threads, including the calling
+         *        one; zero picks the number of hardware threads.
+         */
+        explicit ThreadPool( const unsigned thread_count = 0 );
+        ~ThreadPool();
+
+        /**
+         * @return Number of threads the loops are split between,
+         *         including the calling one.
+         */
+        unsigned thread_count() const;
+
+        /**
+         * @brief Calls @a function for consecutive subranges, at most
+         *        @a chunk long, which together cover [0, count), from
+         *        every thread in the pool, and waits until all of them
+         *        are done. Ranges no longer than one chunk, and every
+         *        range in a single threaded pool, are run directly on
+         *        the calling thread.
+         */
+        void parallel_for( const std::size_t count, const std::size_t chunk, const RangeFunction& function );
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,238 @@
+#ifndef TILEDARRAY2D_H
+#define TILEDARRAY2D_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * @brief A sparse two dimensional array for mostly untouched data.
+ *
+ * The array is split into tiles of 32x32 elements which are grouped
+ * into chunks of 8x8 tiles. Chunks are allocated on the first write
+ * into them and every tile starts out as a reference to a single
+ * read-only tile shared by every array, filled with type_t().
+ * Tiles are copied on write, so copying the whole array is cheap and
+ * the memory used scales with the area which was actually written to.
+ */
+template < typename type_t >
+class TiledArray2d
+{
+    public:
+        static const unsigned tile_shift = 5;
+        static const unsigned tile_size = 1 << tile_shift;
+
+    private:
+        static const unsigned chunk_shift = 3;
+        static const unsigned chunk_size = 1 << chunk_shift;
+
+        struct Tile
+        {
+            type_t cells[ tile_size * tile_size ];
+        };
+
+        struct Chunk
+        {
+            std::shared_ptr< Tile > tiles[ chunk_size * chunk_size ];
+        };
+
+        unsigned m_width;
+        unsigned m_height;
+        unsigned m_chunks_per_row;
+
+        std::vector< std::unique_ptr< Chunk > > m_chunks;
+
+        static const std::shared_ptr< Tile >& default_tile()
+        {
+            static const std::shared_ptr< Tile > tile = []() {
+                std::shared_ptr< Tile > tile( new Tile );
+                for( type_t& cell: tile->cells )
+                    cell = type_t();
+
+                return tile;
+            }();
+
+            return tile;
+        }
+
+        std::size_t chunk_index( const unsigned x, const unsigned y ) const
+        {
+            return (y >> (tile_shift + chunk_shift)) * m_chunks_per_row + (x >> (tile_shift + chunk_shift));
+        }
+
+        static unsigned tile_index( const unsigned x, const unsigned y )
+        {
+            return ((y >> tile_shift) & (chunk_size - 1)) * chunk_size + ((x >> tile_shift) & (chunk_size - 1));
+        }
+
+        static unsigned cell_index( const unsigned x, const unsigned y )
+        {
+            return (y & (tile_size - 1)) * tile_size + (x & (tile_size - 1));
+        }
+
+        void copy_from( const TiledArray2d< type_t >& array )
+        {
+            m_width = array.m_width;
+            m_height = array.m_height;
+            m_chunks_per_row = array.m_chunks_per_row;
+
+            m_chunks.clear();
+            m_chunks.resize( array.m_chunks.size() );
+            for( std::size_t i = 0; i < m_chunks.size(); ++i )
+            {
+                if( array.m_chunks[ i ] )
+                    m_chunks[ i ].reset( new Chunk( *array.m_chunks[ i ] ) );
+            }
+        }
+
+    public:
+        explicit TiledArray2d( const unsigned width, const unsigned height ) :
+            m_width( width ),
+            m_height( height ),
+            m_chunks_per_row( (width + (tile_size << chunk_shift) - 1) >> (tile_shift + chunk_shift) )
+        {
+            const unsigned chunks_per_column = (height + (tile_size << chunk_shift) - 1) >> (tile_shift + chunk_shift);
+            m_chunks.resize( std::size_t( m_chunks_per_row ) * chunks_per_column );
+        }
+
+        TiledArray2d( const TiledArray2d< type_t >& array )
+        {
+            copy_from( array );
+        }
+
+        TiledArray2d< type_t >& operator =( const TiledArray2d< type_t >& array )
+        {
+            if( this != &array )
+                copy_from( array );
+
+            return *this;
+        }
+
+        /**
+         * @return Width of the array.
+         */
+        unsigned width() const
+        {
+            return m_width;
+        }
+
+        /**
+         * @return Height of the array.
+         */
+        unsigned height() const
+        {
+            return m_height;
+        }
+
+        /**
+         * @return The element of the array at given point.
+         */
+        type_t at( const unsigned x, const unsigned y ) const
+        {
+            assert( x < width() );
+            assert( y < height() );
+
+            const Chunk * chunk = m_chunks[ chunk_index( x, y ) ].get();
+            if( chunk == nullptr )
+                return default_tile()->cells[ 0 ];
+
+            return chunk->tiles[ tile_index( x, y ) ]->cells[ cell_index( x, y ) ];
+        }
+
+        /**
+         * @return Whenever the tile containing a given point has never been
+         *         written to, so that all of its elements are type_t().
+         *         A tile which was written to and then set back may not
+         *         be recognized as such.
+         */
+        bool is_untouched_tile( const unsigned x, const unsigned y ) const
+        {
+            assert( x < width() );
+            assert( y < height() );
+
+            const Chunk * chunk = m_chunks[ chunk_index( x, y ) ].get();
+            return chunk == nullptr || chunk->tiles[ tile_index( x, y ) ] == default_tile();
+        }
+
+        /**
+         * @brief Sets the element of the array at given point,
+         *        allocating or unsharing its tile if necessary.
+         * @return Whenever the element has changed.
+         */
+        bool set( const unsigned x, const unsigned y, const type_t value )
+        {
+            assert( x < width() );
+            assert( y < height() );
+
+            std::unique_ptr< Chunk >& chunk = m_chunks[ chunk_index( x, y ) ];
+            if( !chunk )
+            {
+                if( value == default_tile()->cells[ 0 ] )
+                    return false;
+
+                chunk.reset( new Chunk );
+                for( std::shared_ptr< Tile >& tile: chunk->tiles )
+                    tile = default_tile();
+            }
+
+            std::shared_ptr< Tile >& tile = chunk->tiles[ tile_index( x, y ) ];
+            type_t& cell = tile->cells[ cell_index( x, y ) ];
+            if( cell == value )
+                return false;
+
+            /* The tile is shared with another array or is the default one. */
+            if( tile.use_count() > 1 )
+            {
+                tile.reset( new Tile( *tile ) );
+                tile->cells[ cell_index( x, y ) ] = value;
+            }
+            else
+            {
+                /* A copy owned by another thread might have just let go of the tile. */
+                std::atomic_thread_fence( std::memory_order_acquire );
+                cell = value;
+            }
+
+            return true;
+        }
+
+        /**
+         * @return Number of tiles owned, or shared with copies of, this array.
+         */
+        std::size_t allocated_tiles() const
+        {
+            std::size_t count = 0;
+            for( const std::unique_ptr< Chunk >& chunk: m_chunks )
+            {
+                if( !chunk )
+                    continue;
+
+                for( const std::shared_ptr< Tile >& tile: chunk->tiles )
+                {
+                    if( tile != default_tile() )
+                        count++;
+                }
+            }
+
+            return count;
+        }
+
+        /**
+         * @return Approximate number of bytes used by this array.
+         */
+        std::size_t memory_usage() const
+        {
+            std::size_t bytes = sizeof( *this ) + m_chunks.size() * sizeof( std::unique_ptr< Chunk > );
+            for( const std::unique_ptr< Chunk >& chunk: m_chunks )
+            {
+                if( chunk )
+                    bytes += sizeof( Chunk );
+            }
+
+            return bytes + allocated_tiles() * sizeof( Tile );
+        }
+};
+
+#endif // TILEDARRAY2D_H
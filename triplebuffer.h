@@ -0,0 +1,84 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * @brief Passes the latest version of a value from one writer thread
+ *        to one reader thread without either of them ever waiting.
+ *
+ * The writer fills back() and publishes it, the reader takes the most
+ * recently published buffer with acquire() and reads front(). Versions
+ * the reader didn't get to before a newer one was published are skipped.
+ */
+template < typename type_t >
+class TripleBuffer
+{
+    TripleBuffer( const TripleBuffer& ) = delete;
+    TripleBuffer& operator =( const TripleBuffer& ) = delete;
+
+    /* Set on the middle index when it was published but not acquired yet. */
+    static const unsigned fresh_bit = 4;
+
+    type_t m_buffers[ 3 ];
+
+    std::atomic< unsigned > m_middle;
+    unsigned m_back;
+    unsigned m_front;
+
+    public:
+        explicit TripleBuffer() :
+            m_middle( 1 ),
+            m_back( 0 ),
+            m_front( 2 )
+        {
+        }
+
+        /**
+         * @return The buffer the writer is filling; writer only.
+         */
+        type_t& back()
+        {
+            return m_buffers[ m_back ];
+        }
+
+        /**
+         * @brief Hands back() over to the reader and gives the writer
+         *        another buffer, holding an older version; writer only.
+         * @return Whenever the reader has seen the buffer which
+         *         is now in back(); if not, it was skipped.
+         */
+        bool publish()
+        {
+            const unsigned previous = m_middle.exchange( m_back | fresh_bit, std::memory_order_acq_rel );
+            m_back = previous & ~fresh_bit;
+
+            return (previous & fresh_bit) == 0;
+        }
+
+        /**
+         * @brief Makes the most recently published buffer the front one;
+         *        reader only.
+         * @return Whenever there was anything new to take.
+         */
+        bool acquire()
+        {
+            if( (m_middle.load( std::memory_order_relaxed ) & fresh_bit) == 0 )
+                return false;
+
+            const unsigned previous = m_middle.exchange( m_front, std::memory_order_acq_rel );
+            m_front = previous & ~fresh_bit;
+
+            return true;
+        }
+
+        /**
+         * @return The buffer the reader got from the last acquire(); reader only.
+         */
+        const type_t& front() const
+        {
+            return m_buffers[ m_front ];
+        }
+};
+
+#endif // TRIPLEBUFFER_H
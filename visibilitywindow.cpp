@@ -0,0 +1,59 @@
+#include "visibilitywindow.h"
+
+#include <assert.h>
+
+VisibilityWindow::VisibilityWindow() :
+    m_center_x( 0 ),
+    m_center_y( 0 ),
+    m_radius( 0 ),
+    m_size( 0 )
+{
+}
+
+void VisibilityWindow::reset( const unsigned center_x, const unsigned center_y, const unsigned radius )
+{
+    m_center_x = center_x;
+    m_center_y = center_y;
+    m_radius = radius;
+    m_size = radius * 2 + 1;
+
+    m_bits.assign( (m_size * m_size + 63) / 64, 0 );
+}
+
+unsigned VisibilityWindow::center_x() const
+{
+    return m_center_x;
+}
+
+unsigned VisibilityWindow::center_y() const
+{
+    return m_center_y;
+}
+
+unsigned VisibilityWindow::radius() const
+{
+    return m_radius;
+}
+
+bool VisibilityWindow::contains( const unsigned x, const unsigned y ) const
+{
+    /* Points to the left or above the window wrap around to large values. */
+    return x - m_center_x + m_radius < m_size && y - m_center_y + m_radius < m_size;
+}
+
+bool VisibilityWindow::is_visible( const unsigned x, const unsigned y ) const
+{
+    if( !contains( x, y ) )
+        return false;
+
+    const unsigned index = (y - m_center_y + m_radius) * m_size + (x - m_center_x + m_radius);
+    return (m_bits[ index / 64 ] >> (index % 64)) & 1;
+}
+
+void VisibilityWindow::set_visible( const unsigned x, const unsigned y )
+{
+    assert( contains( x, y ) );
+
+    const unsigned index = (y - m_center_y + m_radius) * m_size + (x - m_center_x + m_radius);
+    m_bits[ index / 64 ] |= uint64_t( 1 ) << (index % 64);
+}
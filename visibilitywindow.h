@@ -0,0 +1,61 @@
+#ifndef VISIBILITYWINDOW_H
+#define VISIBILITYWINDOW_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief A square window of (2r+1)x(2r+1) blocks centered on a robot
+ *        which stores what the robot can currently see, one bit per block.
+ *        All of the coordinates are given in blocks of the whole scene.
+ */
+class VisibilityWindow
+{
+    unsigned m_center_x;
+    unsigned m_center_y;
+    unsigned m_radius;
+    unsigned m_size;
+
+    std::vector< uint64_t > m_bits;
+
+    public:
+        explicit VisibilityWindow();
+
+        /**
+         * @brief Recenters the window and marks everything as invisible.
+         */
+        void reset( const unsigned center_x, const unsigned center_y, const unsigned radius );
+
+        /**
+         * @return X position of the block in the center of the window.
+         */
+        unsigned center_x() const;
+
+        /**
+         * @return Y position of the block in the center of the window.
+         */
+        unsigned center_y() const;
+
+        /**
+         * @return Distance from the center to the edge of the window, in blocks.
+         */
+        unsigned radius() const;
+
+        /**
+         * @return Whenever the given point lies inside of the window.
+         */
+        bool contains( const unsigned x, const unsigned y ) const;
+
+        /**
+         * @return Whenever the given point is marked as visible;
+         *         everything outside of the window is invisible.
+         */
+        bool is_visible( const unsigned x, const unsigned y ) const;
+
+        /**
+         * @brief Marks the given point, which must lie inside of the window, as visible.
+         */
+        void set_visible( const unsigned x, const unsigned y );
+};
+
+#endif // VISIBILITYWINDOW_H